@@ -11,11 +11,13 @@ namespace xraft
 			{
 				worker_ = std::thread([this] { 
 					run(); });
-				worker_.detach();
 			}
 			~committer()
 			{
 				stop();
+				//the worker touches our members, wait for it.
+				if (worker_.joinable())
+					worker_.join();
 			}
 			void push(item &&_item)
 			{
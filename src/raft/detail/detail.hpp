@@ -3,12 +3,15 @@
 #include <list>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <queue>
+#include <deque>
 #include <memory>
 #include <functional>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <future>
 #include <fstream>
 #include <chrono>
 #include <cassert>
@@ -16,12 +19,18 @@
 #include <algorithm>  
 #include <atomic>
 #include <random>
+#include <limits>
 
 //deps
 #include <rest_rpc/rpc.hpp>
 
 #ifdef _MSC_VER
 #include<windows.h> 
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 
 #include "macros.hpp"
@@ -30,11 +39,16 @@
 #include "utils.hpp"
 #include "timer.hpp"
 #include "functors.hpp"
+#include "mmap_file.hpp"
+#include "log_cache.hpp"
+#include "committer.hpp"
 #include "filelog.hpp"
 #include "timer.hpp"
-#include "committer.hpp"
+#include "snapshot_codec.hpp"
 #include "snapshot.hpp"
+#include "snapshot_channel.hpp"
 #include "metadata.hpp"
+#include "hard_state.hpp"
 #include "raft_peer.hpp"
 #include "raft_configuration.hpp"
 
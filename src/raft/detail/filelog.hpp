@@ -33,29 +33,22 @@ namespace detail
 		{
 			std::lock_guard<std::mutex> lock(mtx_);
 			filepath_ = filepath;
-			last_log_index_ = -1;
-			log_index_start_ = -1;
 			return open_no_lock();
 		}
 
 		bool write(int64_t index, std::string &&data)
 		{
 			std::lock_guard<std::mutex> lock(mtx_);
-
-			check_apply(data_file_.good());
-			check_apply(index_file_.good());
-			int64_t file_pos = data_file_.tellp();
-			uint32_t len = (uint32_t)data.size();
-			data_file_.write(reinterpret_cast<char*>(&len), sizeof len);
-			data_file_.write(data.data(), data.size());
-			data_file_.sync();
-			check_apply(data_file_.good());
-			index_file_.write(reinterpret_cast<char*>(&index), sizeof(index));
-			index_file_.write(reinterpret_cast<char*>(&file_pos), sizeof(file_pos));
-			index_file_.sync();
-			last_log_index_ = index;
-			check_apply(index_file_.good());
-			return true;
+			check_apply(append_no_lock(index, data));
+			return sync_no_lock();
+		}
+		//write a batch of entries and make them durable with one sync.
+		bool write(std::vector<std::pair<int64_t, std::string>> &batch)
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			for (auto &itr : batch)
+				check_apply(append_no_lock(itr.first, itr.second));
+			return sync_no_lock();
 		}
 
 		bool get_log_entries(int64_t &index,
@@ -65,6 +58,8 @@ namespace detail
 		{
 			std::lock_guard<std::mutex> lock_guard(mtx_);
 			lock.unlock();
+			if (is_sealed_)
+				return get_mapped_log_entries(index, count, log_entries);
 			int64_t data_file_offset = 0;
 			check_apply(get_data_file_offset(index, data_file_offset));
 			data_file_.seekg(data_file_offset, std::ios::beg);
@@ -97,6 +92,12 @@ namespace detail
 		bool get_entry(int64_t index, log_entry &entry)
 		{
 			std::lock_guard<std::mutex> lock_guard(mtx_);
+			if (is_sealed_)
+			{
+				int64_t offset = 0;
+				check_apply(get_data_file_offset(index, offset));
+				return read_mapped_entry(offset, entry);
+			}
 			int64_t data_file_offset = 0;
 			check_apply(get_data_file_offset(index, data_file_offset));
 			data_file_.seekg(data_file_offset, std::ios::beg);
@@ -112,6 +113,15 @@ namespace detail
 			data_file_.seekp(0, std::ios::end);
 			return true;
 		}
+		//map a segment that will not be appended any more,
+		//reads of a sealed segment go through the mapping.
+		bool seal()
+		{
+			std::lock_guard<std::mutex> lock_guard(mtx_);
+			data_file_.flush();
+			index_file_.flush();
+			return map_no_lock();
+		}
 		std::size_t size()
 		{
 			data_file_.seekp(0, std::ios::end);
@@ -128,6 +138,8 @@ namespace detail
 			std::lock_guard<std::mutex> lock_guard(mtx_);
 			int64_t offset = 0;
 			check_apply(get_data_file_offset(index, offset));
+			//the segment will be appended again.
+			unmap_no_lock();
 			data_file_.close();
 			index_file_.close();
 			if (!functors::fs::truncate_suffix()(get_data_file_path(), offset))
@@ -137,7 +149,6 @@ namespace detail
 				return false;
 			}
 			offset = get_index_file_offset(index);
-			last_log_index_ = -1;
 			if (!functors::fs::truncate_suffix()(get_index_file_path(), offset))
 			{
 				//todo log error ;
@@ -152,6 +163,8 @@ namespace detail
 			int64_t offset = 0;
 			if (!get_data_file_offset(index + 1, offset))
 				return false;
+			auto is_sealed = is_sealed_;
+			unmap_no_lock();
 			data_file_.close();
 			index_file_.close();
 			if (!functors::fs::truncate_prefix()(get_data_file_path(), offset))
@@ -159,8 +172,6 @@ namespace detail
 				return false;
 			}
 			offset = get_index_file_offset(index + 1);
-			auto tmp = log_index_start_;
-			log_index_start_ = -1;
 			if (!functors::fs::truncate_prefix()(get_index_file_path(), offset))
 			{
 				//todo log error ;
@@ -208,24 +219,15 @@ namespace detail
 			functors::fs::rename()(old_data_file, get_data_file_path());
 			functors::fs::rename()(old_index_file + ".tmp", get_index_file_path());
 
-			return open_no_lock();
+			check_apply(open_no_lock());
+			return !is_sealed || map_no_lock();
 		}
 		int64_t get_last_log_index()
 		{
-			if (last_log_index_ == -1)
-			{
-				std::lock_guard<std::mutex> lock(mtx_);
-				index_file_.seekg(-(int32_t)(sizeof(int64_t) * 2), std::ios::end);
-				index_file_.read((char*)&last_log_index_, sizeof(last_log_index_));
-				index_file_.seekp(0, std::ios::end);
-				if (index_file_.gcount() != sizeof(last_log_index_) || !index_file_.good())
-				{
-					index_file_.clear(index_file_.goodbit);
-					last_log_index_ = -1;
-					return 0;
-				}
-			}
-			return last_log_index_;
+			std::lock_guard<std::mutex> lock(mtx_);
+			if (offsets_.empty())
+				return 0;
+			return log_index_start_ + (int64_t)offsets_.size() - 1;
 		}
 		int64_t get_log_start()
 		{
@@ -237,16 +239,25 @@ namespace detail
 			std::lock_guard<std::mutex> lock(mtx_);
 			return data_file_.is_open() && index_file_.is_open();
 		}
+		//memory used by the in-memory offset index.
+		std::size_t index_bytes()
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			return offsets_.capacity() * sizeof(int64_t);
+		}
 	private:
 		void move_reset(file &&self)
 		{
 			data_file_ = std::move(self.data_file_);
 			index_file_ = std::move(self.index_file_);
 			filepath_ = std::move(self.filepath_);
-			last_log_index_ = self.last_log_index_;
 			log_index_start_ = self.log_index_start_;
-			self.last_log_index_ = -1;
+			offsets_ = std::move(self.offsets_);
+			data_map_ = std::move(self.data_map_);
+			is_sealed_ = self.is_sealed_;
 			self.log_index_start_ = -1;
+			self.offsets_.clear();
+			self.is_sealed_ = false;
 		}
 		std::string get_data_file_path()
 		{
@@ -269,28 +280,111 @@ namespace detail
 		bool get_data_file_offset(int64_t index, int64_t &data_file_offset)
 		{
 			data_file_offset = 0;
-			auto offset = get_index_file_offset(index);
-			if (offset == 0)
-				return true;
-			index_file_.seekg(offset, std::ios::beg);
-			int64_t index_buffer_;
-			index_file_.read((char*)&index_buffer_, sizeof(int64_t));
-			if (!index_file_.good())
-			{
-				index_file_.clear(index_file_.goodbit);
+			auto diff = index - get_log_start_no_lock();
+			if (diff < 0 || diff >= (int64_t)offsets_.size())
 				return false;
+			data_file_offset = offsets_[diff];
+			return true;
+		}
+		//load the whole .index file into offsets_ once, 
+		//appends keep it up to date afterwards.
+		bool load_index_no_lock()
+		{
+			offsets_.clear();
+			log_index_start_ = -1;
+			index_file_.seekg(0, std::ios::end);
+			auto bytes = (std::size_t)index_file_.tellg();
+			std::vector<int64_t> buffer(bytes / sizeof(int64_t));
+			index_file_.seekg(0, std::ios::beg);
+			index_file_.read((char*)buffer.data(), buffer.size() * sizeof(int64_t));
+			index_file_.clear(index_file_.goodbit);
+			index_file_.seekp(0, std::ios::end);
+			offsets_.reserve(buffer.size() / 2);
+			for (std::size_t i = 0; i + 1 < buffer.size(); i += 2)
+			{
+				if (log_index_start_ == -1)
+					log_index_start_ = buffer[i];
+				if (buffer[i] != log_index_start_ + (int64_t)offsets_.size())
+					//todo log error.
+					return false;
+				offsets_.push_back(buffer[i + 1]);
 			}
-			if (index_buffer_ != index)
-				//todo log error.
+			return true;
+		}
+		bool append_no_lock(int64_t index, const std::string &data)
+		{
+			check_apply(data_file_.good());
+			check_apply(index_file_.good());
+			int64_t file_pos = data_file_.tellp();
+			uint32_t len = (uint32_t)data.size();
+			data_file_.write(reinterpret_cast<char*>(&len), sizeof len);
+			data_file_.write(data.data(), data.size());
+			check_apply(data_file_.good());
+			index_file_.write(reinterpret_cast<char*>(&index), sizeof(index));
+			index_file_.write(reinterpret_cast<char*>(&file_pos), sizeof(file_pos));
+			check_apply(index_file_.good());
+			if (offsets_.empty())
+				log_index_start_ = index;
+			offsets_.push_back(file_pos);
+			return true;
+		}
+		bool sync_no_lock()
+		{
+			data_file_.flush();
+			index_file_.flush();
+			check_apply(data_file_.good());
+			check_apply(index_file_.good());
+			check_apply(functors::fs::fdatasync()(get_data_file_path()));
+			check_apply(functors::fs::fdatasync()(get_index_file_path()));
+			return true;
+		}
+		bool map_no_lock()
+		{
+			check_apply(data_map_.open(get_data_file_path()));
+			is_sealed_ = true;
+			return true;
+		}
+		void unmap_no_lock()
+		{
+			data_map_.close();
+			is_sealed_ = false;
+		}
+		//decode straight from the mapping, no intermediate buffer.
+		bool read_mapped_entry(int64_t &offset, log_entry &entry)
+		{
+			if (offset < 0 || offset + sizeof(uint32_t) > data_map_.size())
 				return false;
-			index_file_.read((char*)&data_file_offset, sizeof(int64_t));
-			if (!index_file_.good())
+			uint32_t len;
+			memcpy(&len, data_map_.data() + offset, sizeof(uint32_t));
+			offset += sizeof(uint32_t);
+			if (offset + len > data_map_.size())
 				return false;
-			index_file_.seekp(0, std::ios::end);
+			uint8_t *ptr = (uint8_t*)(data_map_.data() + offset);
+			entry.from_string(ptr);
+			offset += len;
+			return true;
+		}
+		bool get_mapped_log_entries(int64_t &index,
+			std::size_t &count,
+			std::list<log_entry> &log_entries)
+		{
+			int64_t offset = 0;
+			check_apply(get_data_file_offset(index, offset));
+			do
+			{
+				if (offset >= (int64_t)data_map_.size())
+					return true;
+				log_entry entry;
+				check_apply(read_mapped_entry(offset, entry));
+				log_entries.emplace_back(std::move(entry));
+				++index;
+				--count;
+			} while (count > 0);
 			return true;
 		}
 		bool rm_on_lock()
 		{
+			unmap_no_lock();
 			data_file_.close();
 			index_file_.close();
 			if (!functors::fs::rm()(get_data_file_path()) ||
@@ -300,19 +394,8 @@ namespace detail
 		}
 		int64_t get_log_start_no_lock()
 		{
-			if (log_index_start_ == -1)
-			{
-				index_file_.seekg(0, std::ios::beg);
-				char buffer[sizeof(int64_t)] = { 0 };
-				index_file_.read(buffer, sizeof(buffer));
-				index_file_.seekp(0, std::ios::end);
-				if (index_file_.gcount() != sizeof(buffer))
-				{
-					index_file_.clear(index_file_.goodbit);
-					return 0;
-				}
-				log_index_start_ = *(int64_t*)(buffer);
-			}
+			if (offsets_.empty())
+				return 0;
 			return log_index_start_;
 		}
 		bool open_no_lock()
@@ -330,15 +413,17 @@ namespace detail
 			index_file_.open(get_index_file_path().c_str(), mode);
 			if (!data_file_.good() || !index_file_.good())
 				return false;
-			return true;
+			return load_index_no_lock();
 		}
 
 		std::mutex mtx_;
-		int64_t last_log_index_ = -1;
 		int64_t log_index_start_ = -1;
+		std::vector<int64_t> offsets_;
 		std::fstream data_file_;
 		std::fstream index_file_;
 		std::string filepath_;
+		bool is_sealed_ = false;
+		mmap_file data_map_;
 	};
 
 	class filelog
@@ -366,68 +451,119 @@ namespace detail
 			current_file_ = std::move(logfiles_.rbegin()->second);
 			logfiles_.erase(logfiles_.find(current_file_.get_log_start()));
 			last_index_ = current_file_.get_last_log_index();
+			for (auto &itr : logfiles_)
+				check_apply(itr.second.seal());
 			return true;
 		}
 
+		//group commit: concurrent writers are queued and written by one
+		//thread with a single sync. max_batch_bytes == 0 disables it.
+		void set_group_commit(std::size_t max_batch_bytes, int64_t max_wait_us)
+		{
+			std::lock_guard<std::mutex> lock(group_mtx_);
+			group_commit_max_bytes_ = max_batch_bytes;
+			group_commit_max_wait_us_ = max_wait_us;
+		}
 		bool write(detail::log_entry &&entry, int64_t &index)
 		{
-			std::lock_guard<std::mutex> lock(mtx_);
-			if (entry.index_)
-			{
-				last_index_ = entry.index_;
-			}
-			else
-			{
-				++last_index_;
-				index = last_index_;
-				entry.index_ = last_index_;
-			}
-			std::string buffer = entry.to_string();
-			log_entries_cache_size_ += buffer.size();
-			log_entries_cache_.emplace_back(std::move(entry));
-			check_log_entries_size();
+			if (group_commit_max_bytes_)
+				return group_write(std::move(entry), index);
+
+			std::unique_lock<std::mutex> lock(mtx_);
+			wait_persisted(lock);
+			std::string buffer = append_entry(std::move(entry), index);
 			if (!current_file_.is_open())
 			{
-				current_file_.open(path_ + std::to_string(entry.index_) + ".log");
+				current_file_.open(path_ + std::to_string(last_index_) + ".log");
 			}
 			check_apply(current_file_.write(last_index_, std::move(buffer)));
+			log_entries_cache_.set_stable_index(last_index_);
 			check_current_file_size();
 			return true;
 		}
-		bool get_log_entry(int64_t index, log_entry &entry)
+		//append to the in-memory tail and return at once, the entry is
+		//written to disk in the background and persisted_callback_ 
+		//reports the durable index.
+		bool append(detail::log_entry &&entry, int64_t &index)
 		{
 			std::lock_guard<std::mutex> lock(mtx_);
-			if (get_entry_from_cache(entry, index))
-				return true;
-			if (current_file_.is_open() && 
-				current_file_.get_log_start() <= index &&
-				index <= current_file_.get_last_log_index())
+			std::string buffer = append_entry(std::move(entry), index);
+			persist_queue_.emplace_back(last_index_, std::move(buffer));
+			persister_.push([this] { persist(); });
+			return true;
+		}
+		//batch versions, index is set to the index of the last entry.
+		bool write(std::vector<detail::log_entry> &&entries, int64_t &index)
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			wait_persisted(lock);
+			std::vector<std::pair<int64_t, std::string>> buffers;
+			buffers.reserve(entries.size());
+			for (auto &itr : entries)
 			{
-				auto ret =  current_file_.get_entry(index, entry);
-				if (!ret)
-					return false;
-				return true;
+				auto buffer = append_entry(std::move(itr), index);
+				buffers.emplace_back(last_index_, std::move(buffer));
 			}
-			for (auto itr = logfiles_.begin(); itr != logfiles_.end(); ++itr)
+			if (!current_file_.is_open())
+				check_apply(current_file_.open(path_ + 
+					std::to_string(buffers.front().first) + ".log"));
+			check_apply(current_file_.write(buffers));
+			log_entries_cache_.set_stable_index(last_index_);
+			check_current_file_size();
+			return true;
+		}
+		bool append(std::vector<detail::log_entry> &&entries, int64_t &index)
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			for (auto &itr : entries)
 			{
-				auto &f = itr->second;
-				if (f.get_log_start() <= index &&
-					index <= f.get_last_log_index())
-					return f.get_entry(index, entry);
+				std::string buffer = append_entry(std::move(itr), index);
+				persist_queue_.emplace_back(last_index_, std::move(buffer));
 			}
+			persister_.push([this] { persist(); });
 			return true;
 		}
+		void set_persisted_callback(std::function<void(int64_t)> callback)
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			persisted_callback_ = callback;
+		}
+		//a background write failed: the entries from index on are dropped.
+		void set_persist_failed_callback(std::function<void(int64_t)> callback)
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			persist_failed_callback_ = callback;
+		}
+		//for tests: runs on the persister after a background batch is
+		//written, returning false fails the batch like a write error.
+		void set_persist_fault_hook(std::function<bool(int64_t)> hook)
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			persist_fault_hook_ = hook;
+		}
+		//the last index on disk, once the background writes are done.
+		int64_t get_persisted_index()
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			wait_persisted(lock);
+			return last_index_;
+		}
+		bool get_log_entry(int64_t index, log_entry &entry)
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			return get_log_entry_no_lock(index, entry);
+		}
 		std::list<log_entry> get_log_entries(int64_t index, std::size_t count = 10)
 		{
 			std::unique_lock<std::mutex> lock(mtx_);
 			std::list<log_entry> log_entries;
-			get_entries_from_cache(log_entries, index, count);
+			log_entries_cache_.get(index, count, log_entries);
 			if (count == 0)
 				return std::move(log_entries);
-			for (auto itr = logfiles_.begin(); itr != logfiles_.end(); itr++)
+			for (auto itr = find_logfile(index); itr != logfiles_.end(); itr++)
 			{
 				file &f = itr->second;
-				get_entries_from_cache(log_entries, index, count);
+				log_entries_cache_.get(index, count, log_entries);
 				if (count == 0)
 					return std::move(log_entries);
 				if (f.get_log_start() <= index && index <= f.get_last_log_index())
@@ -439,7 +575,7 @@ namespace detail
 					lock.lock();
 				}
 			}
-			get_entries_from_cache(log_entries, index, count);
+			log_entries_cache_.get(index, count, log_entries);
 			if (count == 0)
 				return std::move(log_entries);
 			if (current_file_.is_open() && 
@@ -454,14 +590,9 @@ namespace detail
 		}
 		void truncate_prefix(int64_t index)
 		{
-			std::lock_guard<std::mutex> lock(mtx_);
-			for (auto itr = log_entries_cache_.begin(); itr != log_entries_cache_.end();)
-			{
-				if (itr->index_ <= index)
-					itr = log_entries_cache_.erase(itr);
-				else
-					++itr;
-			}
+			std::unique_lock<std::mutex> lock(mtx_);
+			wait_persisted(lock);
+			log_entries_cache_.truncate_prefix(index);
 			for (auto itr = logfiles_.begin(); itr != logfiles_.end(); )
 			{
 				if (itr->second.get_last_log_index() <= index)
@@ -494,14 +625,10 @@ namespace detail
 		}
 		void truncate_suffix(int64_t index)
 		{
-			std::lock_guard<std::mutex> lock(mtx_);
-			for (auto itr = log_entries_cache_.begin(); itr != log_entries_cache_.end();)
-			{
-				if (index <= itr->index_)
-					itr = log_entries_cache_.erase(itr);
-				else
-					++itr;
-			}
+			std::unique_lock<std::mutex> lock(mtx_);
+			wait_persisted(lock);
+			log_entries_cache_.truncate_suffix(index);
+			log_entries_cache_.set_stable_index(index - 1);
 			for (auto itr = logfiles_.begin(); itr != logfiles_.end(); ++itr)
 			{
 				if (index <= itr->second.get_last_log_index() &&
@@ -531,8 +658,11 @@ namespace detail
 		int64_t get_last_log_entry_term()
 		{
 			std::lock_guard<std::mutex> lock(mtx_);
-			if (log_entries_cache_.size())
+			if (!log_entries_cache_.empty())
 				return log_entries_cache_.back().term_;
+			log_entry entry;
+			if (last_index_ && get_log_entry_no_lock(last_index_, entry))
+				return entry.term_;
 			return 0;
 		}
 		int64_t get_last_index()
@@ -549,61 +679,212 @@ namespace detail
 				return current_file_.get_log_start();
 			return 0;
 		}
+		//memory used by the offset index of every segment.
+		std::size_t get_index_bytes()
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			std::size_t bytes = current_file_.index_bytes();
+			for (auto &itr : logfiles_)
+				bytes += itr.second.index_bytes();
+			return bytes;
+		}
+		//memory budget of the cached log tail.
+		void set_cache_max_bytes(std::size_t max_bytes)
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			log_entries_cache_.set_max_bytes(max_bytes);
+		}
 		void set_make_snapshot_trigger(std::function<void()> callback)
 		{
 			std::lock_guard<std::mutex> lock(mtx_);
 			make_snapshot_trigger_ = callback;
 		}
 	private:
-		bool get_entries_from_cache(std::list<log_entry> &log_entries,
-			int64_t &index, std::size_t &count)
-		{
-			if (log_entries_cache_.size() && log_entries_cache_.front().index_ <= index)
+		//logfiles_ is keyed by log start, the segment holding
+		//index is the last one starting at or before it.
+		std::map<int64_t, detail::file>::iterator find_logfile(int64_t index)
+		{
+			auto itr = logfiles_.upper_bound(index);
+			if (itr != logfiles_.begin())
+				--itr;
+			return itr;
+		}
+		struct write_request
+		{
+			log_entry entry_;
+			int64_t index_ = 0;
+			bool done_ = false;
+			bool result_ = false;
+		};
+		bool group_write(detail::log_entry &&entry, int64_t &index)
+		{
+			write_request request;
+			request.entry_ = std::move(entry);
+
+			std::unique_lock<std::mutex> lock(group_mtx_);
+			write_queue_.push_back(&request);
+			write_queue_bytes_ += request.entry_.bytes();
+			if (write_queue_bytes_ >= group_commit_max_bytes_)
+				group_cv_.notify_all();
+			while (!request.done_)
 			{
-				for (auto &itr : log_entries_cache_)
+				if (group_flushing_)
 				{
-					if (index == itr.index_)
-					{
-						log_entries.push_back(itr);
-						++index;
-						count--;
-						if (count == 0)
-							return true;
-					}
+					group_cv_.wait(lock);
+					continue;
 				}
-				return true;
+				//no one is flushing, this thread leads the next batch.
+				group_flushing_ = true;
+				group_cv_.wait_for(lock, microseconds(group_commit_max_wait_us_), [this] {
+					return write_queue_bytes_ >= group_commit_max_bytes_;
+				});
+				std::vector<write_request*> batch;
+				batch.swap(write_queue_);
+				write_queue_bytes_ = 0;
+				lock.unlock();
+				auto result = write_batch(batch);
+				lock.lock();
+				//the requests live on the waiters' stacks, they are only
+				//touched under group_mtx_ once written.
+				for (auto &itr : batch)
+				{
+					itr->result_ = result;
+					itr->done_ = true;
+				}
+				group_flushing_ = false;
+				group_cv_.notify_all();
 			}
-			return false;
+			index = request.index_;
+			return request.result_;
 		}
-		bool get_entry_from_cache(log_entry &entry, int64_t index)
+		bool write_batch(std::vector<write_request*> &batch)
 		{
-			if (log_entries_cache_.size() &&
-				log_entries_cache_.front().index_ <= index)
+			std::unique_lock<std::mutex> lock(mtx_);
+			wait_persisted(lock);
+			std::vector<std::pair<int64_t, std::string>> buffers;
+			buffers.reserve(batch.size());
+			for (auto &itr : batch)
 			{
-				for (auto &itr : log_entries_cache_)
-				{
-					if (index == itr.index_)
-					{
-						entry = itr;
-						return true;
-					}
-				}
+				auto buffer = append_entry(std::move(itr->entry_), itr->index_);
+				buffers.emplace_back(last_index_, std::move(buffer));
+			}
+			auto result = true;
+			if (!current_file_.is_open())
+				result = current_file_.open(path_ + 
+					std::to_string(buffers.front().first) + ".log");
+			result = result && current_file_.write(buffers);
+			if (result)
+			{
+				log_entries_cache_.set_stable_index(last_index_);
+				check_current_file_size();
+			}
+			return result;
+		}
+		void persist()
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			if (persist_queue_.empty())
+				return;
+			std::vector<std::pair<int64_t, std::string>> batch;
+			batch.swap(persist_queue_);
+			persisting_ = true;
+			auto result = true;
+			if (!current_file_.is_open())
+				result = current_file_.open(path_ + 
+					std::to_string(batch.front().first) + ".log");
+			auto fault_hook = persist_fault_hook_;
+			//readers are served from the cache while the batch is synced.
+			lock.unlock();
+			result = result && current_file_.write(batch);
+			if (result && fault_hook)
+				result = fault_hook(batch.front().first);
+			lock.lock();
+			persisting_ = false;
+			if (result)
+			{
+				log_entries_cache_.set_stable_index(batch.back().first);
+				check_current_file_size();
+			}
+			else
+			{
+				std::cout << "persist raft log failed, index:" 
+					<< batch.front().first << std::endl;
+				rollback_no_lock(batch.front().first);
+			}
+			persist_cv_.notify_all();
+			auto callback = result ? persisted_callback_ : persist_failed_callback_;
+			lock.unlock();
+			//the callbacks may lock what a writer waiting in wait_persisted
+			//holds, so they never run on the thread that drains the queue.
+			if (callback)
+				notifier_.push([callback, index = result ? batch.back().first : batch.front().first] {
+					callback(index);
+				});
+		}
+		//drop the entries from index on, with the ones queued after them,
+		//so the next append reuses index and the log stays contiguous.
+		void rollback_no_lock(int64_t index)
+		{
+			persist_queue_.clear();
+			log_entries_cache_.truncate_suffix(index);
+			last_index_ = index - 1;
+			log_entries_cache_.set_stable_index(last_index_);
+			if (current_file_.is_open() && current_file_.get_log_start() <= index &&
+				current_file_.get_last_log_index() >= index)
+				current_file_.truncate_suffix(index);
+		}
+		//entries appended in the background must hit the disk before
+		//anything else writes or truncates the log.
+		void wait_persisted(std::unique_lock<std::mutex> &lock)
+		{
+			persist_cv_.wait(lock, [this] {
+				return persist_queue_.empty() && !persisting_;
+			});
+		}
+		std::string append_entry(detail::log_entry &&entry, int64_t &index)
+		{
+			if (entry.index_)
+			{
+				last_index_ = entry.index_;
+			}
+			else
+			{
+				++last_index_;
+				index = last_index_;
+				entry.index_ = last_index_;
 			}
-			return false;
+			std::string buffer = entry.to_string();
+			log_entries_cache_.push(std::move(entry));
+			return buffer;
 		}
-		void check_log_entries_size()
+		bool get_log_entry_no_lock(int64_t index, log_entry &entry)
 		{
-			while (log_entries_cache_.size() &&
-				log_entries_cache_size_ > max_cache_size_)
+			if (log_entries_cache_.get(index, entry))
+				return true;
+			if (current_file_.is_open() && 
+				current_file_.get_log_start() <= index &&
+				index <= current_file_.get_last_log_index())
 			{
-				log_entries_cache_size_ -= log_entries_cache_.front().bytes();
-				log_entries_cache_.pop_front();
+				auto ret =  current_file_.get_entry(index, entry);
+				if (!ret)
+					return false;
+				return true;
 			}
+			auto itr = find_logfile(index);
+			if (itr != logfiles_.end())
+			{
+				auto &f = itr->second;
+				if (f.get_log_start() <= index &&
+					index <= f.get_last_log_index())
+					return f.get_entry(index, entry);
+			}
+			return true;
 		}
 		bool check_current_file_size()
 		{
 			if (current_file_.size() > max_file_size_)
 			{
+				check_apply(current_file_.seal());
 				logfiles_.emplace(current_file_.get_log_start(),
 					std::move(current_file_));
 				std::string filepath = path_ + std::to_string(last_index_ + 1) + ".log";
@@ -623,9 +904,7 @@ namespace detail
 			}
 		}
 		std::mutex mtx_;
-		std::list<log_entry> log_entries_cache_;
-		std::size_t log_entries_cache_size_ = 0;
-		std::size_t max_cache_size_ = 1;
+		log_cache log_entries_cache_;
 		std::size_t max_file_size_ = 1024;
 		int64_t last_index_ = 0;
 		std::string path_;
@@ -634,6 +913,25 @@ namespace detail
 		std::map<int64_t, detail::file> logfiles_;
 		std::size_t max_log_file_count_ = 5;
 		std::function<void()> make_snapshot_trigger_;
+
+		std::mutex group_mtx_;
+		std::condition_variable group_cv_;
+		std::vector<write_request*> write_queue_;
+		std::size_t write_queue_bytes_ = 0;
+		bool group_flushing_ = false;
+		//write reads it without group_mtx_ to pick the path.
+		std::atomic<std::size_t> group_commit_max_bytes_{ 0 };
+		int64_t group_commit_max_wait_us_ = 0;
+
+		std::vector<std::pair<int64_t, std::string>> persist_queue_;
+		bool persisting_ = false;
+		std::condition_variable persist_cv_;
+		std::function<void(int64_t)> persisted_callback_;
+		std::function<void(int64_t)> persist_failed_callback_;
+		std::function<bool(int64_t)> persist_fault_hook_;
+		//destroyed after persister_, which pushes to it.
+		committer<> notifier_;
+		committer<> persister_;
 	};
 }
 
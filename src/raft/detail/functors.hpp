@@ -95,6 +95,37 @@ namespace fs
 			return false;
 		}
 	};
+	struct fdatasync
+	{
+		bool operator()(const std::string &filepath)
+		{
+			HANDLE pHandle = CreateFile(filepath.c_str(),
+				GENERIC_WRITE,
+				FILE_SHARE_READ | FILE_SHARE_WRITE,
+				NULL,
+				OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL,
+				NULL);
+			if (pHandle == INVALID_HANDLE_VALUE)
+				return false;
+			BOOL rc = FlushFileBuffers(pHandle);
+			CloseHandle(pHandle);
+			return !!rc;
+		}
+	};
+#else
+	struct fdatasync
+	{
+		bool operator()(const std::string &filepath)
+		{
+			int fd = ::open(filepath.c_str(), O_WRONLY);
+			if (fd == -1)
+				return false;
+			int rc = ::fdatasync(fd);
+			::close(fd);
+			return rc == 0;
+		}
+	};
 #endif
 	struct rename
 	{
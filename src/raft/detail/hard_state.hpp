@@ -0,0 +1,177 @@
+#pragma once
+namespace xraft
+{
+namespace detail
+{
+	//raft hard state (term, vote, committed, applied) kept in one fixed
+	//size record. the record is written in place, alternating between two
+	//slots, and the valid slot with the higher sequence wins on load, so
+	//a torn write never loses the previous state.
+	//term and vote are synced when set, committed and applied only reach
+	//the disk with the next flush or the next term/vote change.
+	class hard_state
+	{
+	public:
+		enum
+		{
+			max_vote_size = 64,
+			record_size = 128,
+		};
+		hard_state()
+		{
+
+		}
+		~hard_state()
+		{
+			flush();
+		}
+		bool init(const std::string &path)
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			if (!functors::fs::mkdir()(path))
+				return false;
+			filepath_ = path + "hard_state";
+			auto mode = std::ios::binary | std::ios::in | std::ios::out;
+			file_.open(filepath_.c_str(), mode);
+			if (!file_.good())
+			{
+				//first start, create both slots.
+				std::ofstream file(filepath_.c_str(), std::ios::binary | std::ios::trunc);
+				std::string empty(record_size * 2, '\0');
+				file.write(empty.data(), empty.size());
+				file.close();
+				file_.clear();
+				file_.open(filepath_.c_str(), mode);
+				return file_.good();
+			}
+			load();
+			return true;
+		}
+		//false when no record has been written yet.
+		bool is_loaded()
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			return seq_ != 0;
+		}
+		int64_t get_term()
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			return term_;
+		}
+		std::string get_vote()
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			return vote_;
+		}
+		int64_t get_committed()
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			return committed_;
+		}
+		int64_t get_applied()
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			return applied_;
+		}
+		bool set_term_vote(int64_t term, const std::string &vote)
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			if (vote.size() > max_vote_size)
+				return false;
+			term_ = term;
+			vote_ = vote;
+			return write_no_lock();
+		}
+		void set_committed(int64_t index)
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			committed_ = index;
+			dirty_ = true;
+		}
+		void set_applied(int64_t index)
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			applied_ = index;
+			dirty_ = true;
+		}
+		bool flush()
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			if (!dirty_ || !file_.is_open())
+				return true;
+			return write_no_lock();
+		}
+	private:
+		bool write_no_lock()
+		{
+			++seq_;
+			std::string buffer(record_size, '\0');
+			unsigned char *ptr = (unsigned char*)buffer.data();
+			endec::put_uint64(ptr, seq_);
+			endec::put_uint64(ptr, (uint64_t)term_);
+			endec::put_uint64(ptr, (uint64_t)committed_);
+			endec::put_uint64(ptr, (uint64_t)applied_);
+			endec::put_string(ptr, vote_);
+			ptr = (unsigned char*)buffer.data() + record_size - sizeof(uint32_t);
+			endec::put_uint32(ptr, checksum(buffer));
+
+			file_.seekp((seq_ & 1) * record_size, std::ios::beg);
+			file_.write(buffer.data(), buffer.size());
+			file_.flush();
+			if (!file_.good())
+				return false;
+			dirty_ = false;
+			return functors::fs::fdatasync()(filepath_);
+		}
+		void load()
+		{
+			for (int slot = 0; slot < 2; ++slot)
+			{
+				std::string buffer(record_size, '\0');
+				file_.seekg(slot * record_size, std::ios::beg);
+				file_.read((char*)buffer.data(), buffer.size());
+				if (!file_.good())
+				{
+					file_.clear();
+					continue;
+				}
+				unsigned char *ptr = (unsigned char*)buffer.data() + record_size - sizeof(uint32_t);
+				if (endec::get_uint32(ptr) != checksum(buffer))
+					continue;
+				ptr = (unsigned char*)buffer.data();
+				auto seq = endec::get_uint64(ptr);
+				if (seq <= seq_)
+					continue;
+				seq_ = seq;
+				term_ = (int64_t)endec::get_uint64(ptr);
+				committed_ = (int64_t)endec::get_uint64(ptr);
+				applied_ = (int64_t)endec::get_uint64(ptr);
+				auto size = endec::get_uint32(ptr);
+				if (size > max_vote_size)
+					size = 0;
+				vote_.assign((char*)ptr, size);
+			}
+		}
+		//fnv-1a over the record without its checksum.
+		uint32_t checksum(const std::string &buffer)
+		{
+			uint32_t hash = 2166136261u;
+			for (std::size_t i = 0; i < record_size - sizeof(uint32_t); ++i)
+			{
+				hash ^= (uint8_t)buffer[i];
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+		std::mutex mtx_;
+		std::fstream file_;
+		std::string filepath_;
+		uint64_t seq_ = 0;
+		int64_t term_ = 0;
+		std::string vote_;
+		int64_t committed_ = 0;
+		int64_t applied_ = 0;
+		bool dirty_ = false;
+	};
+}
+}
\ No newline at end of file
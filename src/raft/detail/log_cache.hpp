@@ -0,0 +1,148 @@
+#pragma once
+namespace xraft
+{
+namespace detail
+{
+	//ring buffer of the newest log entries, addressed by log index.
+	//entries are evicted from the front once the byte budget is exceeded,
+	//the newest entry is always kept.
+	class log_cache
+	{
+	public:
+		log_cache()
+		{
+
+		}
+		void set_max_bytes(std::size_t max_bytes)
+		{
+			max_bytes_ = max_bytes;
+			evict();
+		}
+		//entries after the stable index are not on disk yet 
+		//and are never evicted.
+		void set_stable_index(int64_t index)
+		{
+			stable_index_ = index;
+			evict();
+		}
+		void push(log_entry &&entry)
+		{
+			//not contiguous with the tail, start over from this entry.
+			if (size_ && entry.index_ != get_last_index() + 1)
+				clear();
+			if (size_ == entries_.size())
+				grow();
+			if (size_ == 0)
+				first_index_ = entry.index_;
+			bytes_ += entry.bytes();
+			slot(first_index_ + (int64_t)size_) = std::move(entry);
+			++size_;
+			evict();
+		}
+		bool get(int64_t index, log_entry &entry)
+		{
+			if (!contains(index))
+				return false;
+			entry = slot(index);
+			return true;
+		}
+		//copy entries [index, index + count) that are cached,
+		//index and count are advanced past the copied entries.
+		bool get(int64_t &index, std::size_t &count, std::list<log_entry> &log_entries)
+		{
+			if (!contains(index))
+				return false;
+			while (count && contains(index))
+			{
+				log_entries.push_back(slot(index));
+				++index;
+				--count;
+			}
+			return true;
+		}
+		//drop every entry <= index.
+		void truncate_prefix(int64_t index)
+		{
+			while (size_ && first_index_ <= index)
+				pop_front();
+		}
+		//drop every entry >= index.
+		void truncate_suffix(int64_t index)
+		{
+			while (size_ && index <= get_last_index())
+				pop_back();
+		}
+		void clear()
+		{
+			while (size_)
+				pop_back();
+		}
+		bool empty() const
+		{
+			return size_ == 0;
+		}
+		const log_entry &back()
+		{
+			return slot(get_last_index());
+		}
+		int64_t get_first_index() const
+		{
+			return first_index_;
+		}
+		int64_t get_last_index() const
+		{
+			return first_index_ + (int64_t)size_ - 1;
+		}
+		std::size_t bytes() const
+		{
+			return bytes_;
+		}
+	private:
+		bool contains(int64_t index) const
+		{
+			return size_ && first_index_ <= index && index <= get_last_index();
+		}
+		log_entry &slot(int64_t index)
+		{
+			auto pos = (head_ + (std::size_t)(index - first_index_)) & (entries_.size() - 1);
+			return entries_[pos];
+		}
+		void grow()
+		{
+			std::vector<log_entry> entries(entries_.empty() ? 16 : entries_.size() * 2);
+			for (std::size_t i = 0; i < size_; ++i)
+				entries[i] = std::move(slot(first_index_ + (int64_t)i));
+			entries_.swap(entries);
+			head_ = 0;
+		}
+		void pop_front()
+		{
+			auto &entry = slot(first_index_);
+			bytes_ -= entry.bytes();
+			entry = log_entry();
+			head_ = (head_ + 1) & (entries_.size() - 1);
+			++first_index_;
+			--size_;
+		}
+		void pop_back()
+		{
+			auto &entry = slot(get_last_index());
+			bytes_ -= entry.bytes();
+			entry = log_entry();
+			--size_;
+		}
+		void evict()
+		{
+			while (size_ > 1 && bytes_ > max_bytes_ && first_index_ <= stable_index_)
+				pop_front();
+		}
+		std::vector<log_entry> entries_;
+		std::size_t head_ = 0;
+		std::size_t size_ = 0;
+		int64_t first_index_ = 0;
+		std::size_t bytes_ = 0;
+		std::size_t max_bytes_ = 16 * 1024 * 1024;
+		int64_t stable_index_ = std::numeric_limits<int64_t>::max();
+	};
+}
+}
@@ -29,11 +29,14 @@ namespace detail
 		}
 		~metadata()
 		{
-			max_log_file_ = 0;
-			make_snapshot();
+			wait_compaction();
+			std::lock_guard<mutex> lock(mtx_);
+			if (!path_.empty())
+				make_snapshot();
 		}
 		void clear()
 		{
+			wait_compaction();
 			std::lock_guard<mutex> lock(mtx_);
 			string_map_.clear();
 			integral_map_.clear();
@@ -59,7 +62,7 @@ namespace detail
 			if (!write_log(build_log(key, value, op::e_set)))
 				return false;
 			string_map_[key] = value;
-			return true;
+			return try_make_snapshot();
 		}
 		bool set(const std::string &key, int64_t value)
 		{
@@ -67,7 +70,7 @@ namespace detail
 			if (!write_log(build_log(key, value, op::e_set)))
 				return false;
 			integral_map_[key] = value;
-			return true;
+			return try_make_snapshot();
 		}
 		bool del(const std::string &key)
 		{
@@ -82,7 +85,19 @@ namespace detail
 			auto itr2 = integral_map_.find(key);
 			if (itr2 != integral_map_.end())
 				integral_map_.erase(itr2);
-			return true;
+			return try_make_snapshot();
+		}
+		//log size that starts a compaction.
+		void set_max_log_file(std::size_t max_log_file)
+		{
+			std::lock_guard<mutex> lock(mtx_);
+			max_log_file_ = max_log_file;
+		}
+		//wait for a running background compaction to finish.
+		void wait_compaction()
+		{
+			std::unique_lock<std::mutex> lock(compact_mtx_);
+			compact_cv_.wait(lock, [this] { return !compacting_; });
 		}
 		bool get(const std::string &key, std::string &value)
 		{
@@ -173,37 +188,46 @@ namespace detail
 			log_.write((char*)(buffer), sizeof (buffer));
 			log_.write(data.data(), data.size());
 			log_.flush();
-			return log_.good() && try_make_snapshot();
-
+			return log_.good();
 		}
 		bool load()
 		{
-			std::vector<std::string> files = functors::fs::ls_files()(path_);
-			if (files.empty())
-			{
-				return reopen_log();
-			}
-			std::sort(files.begin(), files.end(),std::greater<std::string>());
-			for (auto &file: files)
+			uint64_t index = 0;
+			for (auto &file : functors::fs::ls_files()(path_))
 			{
 				auto end = file.find(".metadata");
 				if (end == std::string::npos)
 					continue;
-				std::size_t beg = file.find_last_of('/') + 1;
-				if (beg == std::string::npos)
-					beg = file.find_last_of('\\') + 1;
-				std::string index = file.substr(beg, end - beg);
-				index_ = std::strtoull(index.c_str(), 0, 10);
-				if (errno == ERANGE || index_ == 0)
-				{
-					//todo log error
-					assert(false);
-				}
-				if (!load_file(get_snapshot_file()) || !load_file(get_log_file()))
-					return false;
-				return reopen_log(false);
+				auto beg = file.find_last_of("/\\");
+				beg = beg == std::string::npos ? 0 : beg + 1;
+				auto file_index = std::strtoull(file.substr(beg, end - beg).c_str(), 0, 10);
+				if (file_index > index)
+					index = file_index;
 			}
-			return false;
+			if (index == 0)
+				return reopen_log() && touch_metadata_file(index_);
+			index_ = index;
+			if (!load_file(get_snapshot_file(index_)) || !load_file(get_log_file(index_)))
+				return false;
+			//left behind when the last compaction stopped before its cleanup.
+			if (!rm_old_files(index_))
+				return false;
+			//a compaction was cut short after the writes moved on to
+			//the next log, replay it and finish the compaction.
+			if (!file_exists(get_log_file(index_ + 1)))
+				return reopen_log(false);
+			if (!load_file(get_log_file(index_ + 1)))
+				return false;
+			++index_;
+			if (!reopen_log(false))
+				return false;
+			start_compaction();
+			return true;
+		}
+		bool file_exists(const std::string &filepath)
+		{
+			std::ifstream file(filepath.c_str());
+			return file.good();
 		}
 		template<typename T>
 		bool write(std::ofstream &file, T &map)
@@ -266,7 +290,7 @@ namespace detail
 						auto value = endec::get_uint64(ptr);
 						integral_map_[key] = value;
 					}
-					else if (static_cast<op>(_op) == op::e_set)
+					else if (static_cast<op>(_op) == op::e_del)
 					{
 						auto key = endec::get_string(ptr);
 						auto itr = integral_map_.find(key);
@@ -294,42 +318,80 @@ namespace detail
 		{
 			if ((int)max_log_file_ > log_.tellp())
 				return true;
-			return make_snapshot();
+			{
+				std::lock_guard<std::mutex> lock(compact_mtx_);
+				if (compacting_)
+					return true;
+			}
+			//switch the writes to a new log, the old log and 
+			//the maps as of now are compacted in the background.
+			++index_;
+			if (!reopen_log())
+				return false;
+			start_compaction();
+			return true;
+		}
+		void start_compaction()
+		{
+			{
+				std::lock_guard<std::mutex> lock(compact_mtx_);
+				compacting_ = true;
+			}
+			auto index = index_;
+			auto string_map = string_map_;
+			auto integral_map = integral_map_;
+			compactor_.push([this, index, string_map, integral_map]() mutable {
+				if (!compact(index, string_map, integral_map))
+					std::cout << "metadata compaction failed, index:" << index << std::endl;
+				std::lock_guard<std::mutex> lock(compact_mtx_);
+				compacting_ = false;
+				compact_cv_.notify_all();
+			});
 		}
 		bool make_snapshot()
+		{
+			++index_;
+			if (!reopen_log())
+				return false;
+			return compact(index_, string_map_, integral_map_);
+		}
+		//the .metadata file marks index.data as complete, until it exists
+		//load still starts from the previous generation.
+		bool compact(uint64_t index, 
+			std::map<std::string, std::string> &string_map,
+			std::map<std::string, int64_t> &integral_map)
 		{
 			std::ofstream file;
-			int mode = std::ios::binary |
+			auto mode = std::ios::binary |
 				std::ios::trunc |
 				std::ios::out;
-			++index_;
-			file.open(get_snapshot_file().c_str(), mode);
+			file.open(get_snapshot_file(index).c_str(), mode);
 			if (!file.good())
 			{
 				//process error
 				return false;
 			}
-			if (!write(file, string_map_))
+			if (!write(file, string_map))
 			{
 				//process error
 				return false;
 			}
-			if (!write(file, integral_map_))
+			if (!write(file, integral_map))
 			{
 				//process error
 				return false;
 			}
 			file.flush();
 			file.close();
-			if (!reopen_log())
+			if (!functors::fs::fdatasync()(get_snapshot_file(index)))
 			{
 				return false;
 			}
-			if (!touch_metadata_file())
+			if (!touch_metadata_file(index))
 			{
 				return false;
 			}
-			if (!rm_old_files())
+			if (!rm_old_files(index))
 			{
 				return false;
 			}
@@ -344,60 +406,41 @@ namespace detail
 			else
 				mode |= std::ios::app;
 
-			log_.open(get_log_file().c_str(), mode);
-			touch_metadata_file();
+			log_.open(get_log_file(index_).c_str(), mode);
 			return log_.good();
 		}
-		bool touch_metadata_file()
+		bool touch_metadata_file(uint64_t index)
 		{
 			std::ofstream file;
-			file.open(get_metadata_file().c_str());
+			file.open(get_metadata_file(index).c_str());
 			auto is_ok = file.good();
 			file.close();
 			return is_ok;
 		}
-		bool rm_old_files()
+		bool rm_old_files(uint64_t index)
 		{
-			if (!functors::fs::rm()(get_old_log_file()))
+			for (auto &file : { get_log_file(index - 1), 
+				get_snapshot_file(index - 1), get_metadata_file(index - 1) })
 			{
-				//todo log error
-				return false;
-			}
-			if (!functors::fs::rm()(get_old_snapshot_file()))
-			{
-				//todo log error
-				return false;
-			}
-			if (!functors::fs::rm()(get_old_metadata_file()))
-			{
-				//todo log error
-				return false;
+				if (file_exists(file) && !functors::fs::rm()(file))
+				{
+					//todo log error
+					return false;
+				}
 			}
 			return true;
 		}
-		std::string get_snapshot_file()
-		{
-			return path_ + std::to_string(index_)+ ".data";
-		}
-		std::string get_log_file()
-		{
-			return path_ + std::to_string(index_) + ".Log";
-		}
-		std::string get_metadata_file()
-		{
-			return path_ + std::to_string(index_) + ".metadata";
-		}
-		std::string get_old_snapshot_file()
+		std::string get_snapshot_file(uint64_t index)
 		{
-			return path_ + std::to_string(index_ - 1) + ".data";
+			return path_ + std::to_string(index)+ ".data";
 		}
-		std::string get_old_log_file()
+		std::string get_log_file(uint64_t index)
 		{
-			return path_ + std::to_string(index_ - 1) + ".Log";
+			return path_ + std::to_string(index) + ".Log";
 		}
-		std::string get_old_metadata_file()
+		std::string get_metadata_file(uint64_t index)
 		{
-			return path_ + std::to_string(index_ - 1) + ".metadata";
+			return path_ + std::to_string(index) + ".metadata";
 		}
 		uint64_t index_ = 1;
 		std::size_t max_log_file_ = 10 * 1024 * 1024;
@@ -406,6 +449,11 @@ namespace detail
 		mutex mtx_;
 		std::map<std::string, std::string> string_map_;
 		std::map<std::string, int64_t> integral_map_;
+
+		std::mutex compact_mtx_;
+		std::condition_variable compact_cv_;
+		bool compacting_ = false;
+		committer<> compactor_;
 	};
 }
 }
\ No newline at end of file
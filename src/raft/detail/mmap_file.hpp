@@ -0,0 +1,150 @@
+#pragma once
+namespace xraft
+{
+namespace detail
+{
+	//read only memory map of a whole file.
+	class mmap_file
+	{
+	public:
+		mmap_file()
+		{
+
+		}
+		~mmap_file()
+		{
+			close();
+		}
+		mmap_file(const mmap_file &) = delete;
+		mmap_file &operator = (const mmap_file &) = delete;
+		mmap_file(mmap_file &&self)
+		{
+			move_reset(std::move(self));
+		}
+		mmap_file &operator = (mmap_file &&self)
+		{
+			if (&self == this)
+				return *this;
+			close();
+			move_reset(std::move(self));
+			return *this;
+		}
+		bool open(const std::string &filepath)
+		{
+			close();
+#ifdef _MSC_VER
+			file_ = CreateFile(filepath.c_str(),
+				GENERIC_READ,
+				FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+				NULL,
+				OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS,
+				NULL);
+			if (file_ == INVALID_HANDLE_VALUE)
+				return false;
+			LARGE_INTEGER file_size;
+			if (!GetFileSizeEx(file_, &file_size))
+			{
+				close();
+				return false;
+			}
+			size_ = (std::size_t)file_size.QuadPart;
+			is_open_ = true;
+			if (size_ == 0)
+				return true;
+			mapping_ = CreateFileMapping(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping_ == NULL)
+			{
+				close();
+				return false;
+			}
+			data_ = (const char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+			if (data_ == nullptr)
+			{
+				close();
+				return false;
+			}
+#else
+			int fd = ::open(filepath.c_str(), O_RDONLY);
+			if (fd == -1)
+				return false;
+			struct stat st;
+			if (::fstat(fd, &st) == -1)
+			{
+				::close(fd);
+				return false;
+			}
+			size_ = (std::size_t)st.st_size;
+			void *addr = MAP_FAILED;
+			if (size_)
+				addr = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+			//the mapping stays valid after the descriptor is closed.
+			::close(fd);
+			if (size_ && addr == MAP_FAILED)
+			{
+				size_ = 0;
+				return false;
+			}
+			if (size_)
+				data_ = (const char*)addr;
+			is_open_ = true;
+#endif
+			return true;
+		}
+		void close()
+		{
+#ifdef _MSC_VER
+			if (data_)
+				UnmapViewOfFile(data_);
+			if (mapping_ != NULL)
+				CloseHandle(mapping_);
+			if (file_ != INVALID_HANDLE_VALUE)
+				CloseHandle(file_);
+			mapping_ = NULL;
+			file_ = INVALID_HANDLE_VALUE;
+#else
+			if (data_)
+				::munmap((void*)data_, size_);
+#endif
+			data_ = nullptr;
+			size_ = 0;
+			is_open_ = false;
+		}
+		bool is_open() const
+		{
+			return is_open_;
+		}
+		const char *data() const
+		{
+			return data_;
+		}
+		std::size_t size() const
+		{
+			return size_;
+		}
+	private:
+		void move_reset(mmap_file &&self)
+		{
+#ifdef _MSC_VER
+			file_ = self.file_;
+			mapping_ = self.mapping_;
+			self.file_ = INVALID_HANDLE_VALUE;
+			self.mapping_ = NULL;
+#endif
+			data_ = self.data_;
+			size_ = self.size_;
+			is_open_ = self.is_open_;
+			self.data_ = nullptr;
+			self.size_ = 0;
+			self.is_open_ = false;
+		}
+#ifdef _MSC_VER
+		HANDLE file_ = INVALID_HANDLE_VALUE;
+		HANDLE mapping_ = NULL;
+#endif
+		const char *data_ = nullptr;
+		std::size_t size_ = 0;
+		bool is_open_ = false;
+	};
+}
+}
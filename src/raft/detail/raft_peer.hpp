@@ -11,6 +11,8 @@ namespace detail
 		TIMAX_DEFINE_PROTOCOL(append_entries_request, detail::append_entries_response(detail::append_entries_request));
 		TIMAX_DEFINE_PROTOCOL(vote_request, detail::vote_response(detail::vote_request));
 		TIMAX_DEFINE_PROTOCOL(install_snapshot, detail::install_snapshot_response(detail::install_snapshot_request));
+		TIMAX_DEFINE_PROTOCOL(read_index_request, detail::read_index_response(detail::read_index_request));
+		TIMAX_DEFINE_PROTOCOL(read_index_reply, bool(detail::read_index_response));
 	}
 
 	class raft_peer
@@ -46,6 +48,40 @@ namespace detail
 			utils::lock_guard locker(mtx_);
 			cv_.notify_one();
 		}
+		//send an AppendEntries now and report the round when the peer 
+		//answers it without a higher term.
+		void request_read_round(uint64_t round)
+		{
+			read_round_ = round;
+			notify();
+		}
+		using read_index_response_handle = std::function<void(bool, const read_index_response &)>;
+		//called from the reading thread, not the peer thread.
+		void send_read_index_request(const read_index_request &req,
+			read_index_response_handle &&callback)
+		{
+			auto handle = std::make_shared<read_index_response_handle>(std::move(callback));
+			async_rpc_client_.call(endpoint_, RPC::read_index_request, req)
+				.on_ok([handle](auto const& response)
+			{
+				(*handle)(true, response);
+			})
+				.on_error([handle](auto const& e)
+			{
+				std::cout << e.get_error_message() << std::endl;
+				(*handle)(false, read_index_response());
+			});
+		}
+		//the leader's answer to a read index request, sent when its
+		//heartbeat round is done. the request itself returns at once.
+		void send_read_index_reply(const read_index_response &reply)
+		{
+			async_rpc_client_.call(endpoint_, RPC::read_index_reply, reply)
+				.on_error([](auto const& e)
+			{
+				std::cout << e.get_error_message() << std::endl;
+			});
+		}
 		void start()
 		{
 			peer_thread_ = std::thread([this] {  run(); });
@@ -63,10 +99,20 @@ namespace detail
 		std::function<vote_request()> build_vote_request_;
 		std::function<void(const vote_response &)> vote_response_callback_;
 		std::function<void(int64_t)> new_term_callback_;
-		std::function<void(const std::vector<int64_t>&)> append_entries_success_callback_;
+		//reports the highest index known to match the leader's log.
+		std::function<void(int64_t)> append_entries_success_callback_;
+		//the peer still follows us as of this read round.
+		std::function<void(uint64_t)> read_round_callback_;
+		//the peer accepted our leadership at a steady clock time (ms) no
+		//earlier than this one, the send time of the acked request.
+		std::function<void(int64_t)> lease_ack_callback_;
 		std::function<std::string()> get_snapshot_path_;
 		std::string raft_id_;
 		raft_config::raft_node myself_;
+		std::size_t pipeline_window_ = 1;
+		std::size_t snapshot_chunk_bytes_ = 1024 * 1024;
+		std::size_t snapshot_window_ = 4;
+		int snapshot_channel_port_offset_ = 0;
 	private:
 		void run()
 		{
@@ -92,11 +138,11 @@ namespace detail
 					int64_t index = get_last_log_index_();
 					if (!next_index_ || next_index_ > index)
 						next_index_ = index;
-					if (index == match_index_ && send_heartbeat_)
+					if (index == match_index_ && send_heartbeat_ && !read_round_pending())
 					{
 						std::cout << "index:" << index << "match_index" << match_index_ << std::endl;
 						send_heartbeat_ = false;
-						do_sleep(next_heartbeat_delay());
+						wait_heartbeat(next_heartbeat_delay());
 						continue;
 					}
 					auto request = build_append_entries_request_(next_index_);
@@ -105,8 +151,17 @@ namespace detail
 						send_install_snapshot_req();
 						continue;
 					}
+					auto read_round = read_round_.load();
+					read_round_sent_ = read_round;
+					auto send_time = steady_now();
 					auto response = send_append_entries_request(request);
 					update_heartbeat_time();
+					if (get_current_term_() >= response.term_)
+					{
+						if (read_round)
+							read_round_callback_(read_round);
+						lease_ack_callback_(send_time);
+					}
 					if (!response.success_)
 					{
 						match_index_ = 0;
@@ -125,12 +180,9 @@ namespace detail
 
 					if (request.entries_.empty())
 						continue;
-
-					std::vector<int64_t> indexs;
-					indexs.reserve(request.entries_.size());
-					for (auto &itr : request.entries_)
-						indexs.push_back(itr.index_);
-					append_entries_success_callback_(indexs);
+					//entries after the request may not match the leader's log.
+					append_entries_success_callback_(request.prev_log_index_ + 
+						(int64_t)request.entries_.size());
 				}
 				catch (std::exception &e)
 				{
@@ -144,12 +196,176 @@ namespace detail
 			} while (true);
 		}
 
+		//keep up to pipeline_window_ AppendEntries in flight, next_index_ 
+		//advances when a request is sent and rolls back on rejection.
+		void do_pipeline_append_entries()
+		{
+			{
+				utils::lock_guard lock(mtx_);
+				next_index_ = 0;
+				match_index_ = 0;
+				inflight_ = 0;
+				++pipeline_epoch_;
+			}
+			send_heartbeat_ = false;
+			do
+			{
+				try
+				{
+					if (try_execute_cmd())
+					{
+						//responses still in flight belong to the old role.
+						utils::lock_guard lock(mtx_);
+						++pipeline_epoch_;
+						inflight_ = 0;
+						break;
+					}
+					int64_t index = get_last_log_index_();
+					std::unique_lock<std::mutex> lock(mtx_);
+					if (inflight_ >= pipeline_window_)
+					{
+						cv_.wait_for(lock, milliseconds(heatbeat_inteval_), [this] {
+							return inflight_ < pipeline_window_ || !cmd_queue_.empty();
+						});
+						continue;
+					}
+					bool has_new_entries = next_index_ && next_index_ <= index;
+					auto elapsed = duration_cast<milliseconds>(
+						high_resolution_clock::now() - last_heart_beat_).count();
+					if (!has_new_entries && send_heartbeat_ && elapsed < heatbeat_inteval_ &&
+						!read_round_pending())
+					{
+						cv_.wait_for(lock, milliseconds(heatbeat_inteval_ - elapsed), [this] {
+							return (next_index_ && get_last_log_index_() >= next_index_) ||
+								!cmd_queue_.empty() || read_round_pending();
+						});
+						continue;
+					}
+					if (!next_index_ || next_index_ > index)
+						next_index_ = index;
+					auto next_index = next_index_;
+					auto epoch = pipeline_epoch_;
+					lock.unlock();
+
+					auto request = build_append_entries_request_(next_index);
+					if (request.entries_.empty() && next_index < index)
+					{
+						lock.lock();
+						cv_.wait_for(lock, milliseconds(heatbeat_inteval_), [this] {
+							return inflight_ == 0 || !cmd_queue_.empty() || stop_;
+						});
+						if (stop_)
+							return;
+						if (!cmd_queue_.empty())
+							continue;
+						if (inflight_)
+						{
+							//responses that did not come back are dropped.
+							++pipeline_epoch_;
+							inflight_ = 0;
+						}
+						lock.unlock();
+						send_install_snapshot_req();
+						lock.lock();
+						++pipeline_epoch_;
+						continue;
+					}
+
+					lock.lock();
+					if (epoch != pipeline_epoch_)
+						continue;
+					if (request.entries_.size())
+						next_index_ = request.entries_.back().index_ + 1;
+					++inflight_;
+					auto read_round = read_round_.load();
+					read_round_sent_ = read_round;
+					lock.unlock();
+
+					update_heartbeat_time();
+					send_append_entries_request(request, epoch, read_round);
+				}
+				catch (std::exception &e)
+				{
+					std::cout << e.what() << std::endl;
+				}
+				catch (timax::rpc::exception const& e)
+				{
+					std::cout << e.get_error_message() << std::endl;
+				}
+			} while (true);
+		}
+
 		append_entries_response 
 			send_append_entries_request(const append_entries_request &req)
 		{
 			return rpc_client_.call(endpoint_, RPC::append_entries_request, req);
 		}
 
+		void send_append_entries_request(const append_entries_request &req, 
+			uint64_t epoch, uint64_t read_round)
+		{
+			auto last_index = req.prev_log_index_ + (int64_t)req.entries_.size();
+			auto send_time = steady_now();
+			async_rpc_client_.call(endpoint_, RPC::append_entries_request, req)
+				.on_ok([this, epoch, last_index, read_round, send_time](auto const& response)
+			{
+				//the round was sent after it started, a stale epoch still counts.
+				if (get_current_term_() >= response.term_)
+				{
+					if (read_round)
+						read_round_callback_(read_round);
+					lease_ack_callback_(send_time);
+				}
+				handle_append_entries_response(epoch, last_index, response);
+			})
+				.on_error([this, epoch](auto const& e)
+			{
+				std::cout << e.get_error_message() << std::endl;
+				rollback_pipeline(epoch, 0);
+			});
+		}
+
+		void handle_append_entries_response(uint64_t epoch, int64_t last_index,
+			const append_entries_response &response)
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			if (epoch != pipeline_epoch_)
+				return;
+			--inflight_;
+			if (!response.success_)
+			{
+				lock.unlock();
+				if (get_current_term_() < response.term_)
+				{
+					new_term_callback_(response.term_);
+					return;
+				}
+				rollback_pipeline(epoch, response.last_log_index_ + 1);
+				return;
+			}
+			if (last_index > match_index_)
+				match_index_ = last_index;
+			cv_.notify_one();
+			lock.unlock();
+			append_entries_success_callback_(last_index);
+		}
+
+		//drop the rest of the window, responses of the old epoch are ignored.
+		void rollback_pipeline(uint64_t epoch, int64_t next_index)
+		{
+			utils::lock_guard lock(mtx_);
+			if (epoch != pipeline_epoch_)
+				return;
+			++pipeline_epoch_;
+			inflight_ = 0;
+			next_index_ = next_index ? next_index : match_index_ + 1;
+			if (next_index_ == 0)
+				next_index_ = 1;
+			cv_.notify_one();
+		}
+
+		//stream the snapshot with up to snapshot_window_ chunks in flight,
+		//starting from what the follower already stored.
 		void send_install_snapshot_req()
 		{
 			snapshot_reader reader;
@@ -164,53 +380,160 @@ namespace detail
 			if (!reader.read_sanpshot_head(head))
 				throw std::runtime_error("read_sanpshot_head failed");
 
-			std::ifstream &file = reader.get_snapshot_stream();
-			file.seekg(0, std::ios::beg);
+			std::ifstream &file = reader.get_file_stream();
+			file.seekg(0, std::ios::end);
+			int64_t file_size = file.tellg();
+			int64_t offset = probe_snapshot(head);
+			if (offset < 0)
+				return;
+			if (snapshot_channel_port_offset_ && offset < file_size)
+				offset = stream_snapshot(head, filepath, offset, file_size);
+			bool done_sent = false;
+			{
+				utils::lock_guard lock(mtx_);
+				++snapshot_epoch_;
+				snapshot_inflight_ = 0;
+				snapshot_resume_ = e_no_resume;
+			}
 			do
 			{
 				if (try_execute_cmd())
+				{
+					utils::lock_guard lock(mtx_);
+					++snapshot_epoch_;
 					break;
-				install_snapshot_request request;
-				request.term_ = get_current_term_();
-				request.leader_id_ = raft_id_;
-				request.last_included_term_ = head.last_included_term_;
-				request.last_snapshot_index_ = head.last_included_index_;
-				request.offset_ = file.tellg();
-				std::cout << "request.offset_: " << request.offset_ << std::endl;
-				request.data_.resize(1024*1024);
-				file.read((char*)request.data_.data(), request.data_.size());
-				request.data_.resize(file.gcount());
-				request.done_ = file.eof();
-				try
+				}
+				std::unique_lock<std::mutex> lock(mtx_);
+				if (snapshot_resume_ != e_no_resume)
 				{
-
-					auto resp = rpc_client_.call(endpoint_, RPC::install_snapshot,  request);
-					if (resp.term_ > request.term_)
-					{
-						new_term_callback_(resp.term_);
-						return;
-					}
-					else if (resp.bytes_stored_ != 
-							request.offset_ + request.data_.size())
+					offset = snapshot_resume_;
+					snapshot_resume_ = e_no_resume;
+					done_sent = false;
+					if (offset == e_probe)
 					{
-						file.clear(file.goodbit);
-						file.seekg(resp.bytes_stored_, std::ios::beg);
-					}
-					else if (request.done_)
-					{
-						std::cout << "send snapshot done " << std::endl;
-						match_index_ = head.last_included_index_;
-						next_index_ = match_index_ + 1;
-						break;
+						lock.unlock();
+						offset = probe_snapshot(head);
+						lock.lock();
 					}
+					if (offset < 0)
+						return;
+				}
+				if (done_sent && snapshot_inflight_ == 0)
+				{
+					std::cout << "send snapshot done " << std::endl;
+					match_index_ = head.last_included_index_;
+					next_index_ = match_index_ + 1;
+					break;
 				}
-				catch (const std::exception& e)
+				if (done_sent || snapshot_inflight_ >= snapshot_window_)
 				{
-					throw e;
+					cv_.wait_for(lock, milliseconds(heatbeat_inteval_), [this] {
+						return snapshot_inflight_ < snapshot_window_ ||
+							snapshot_resume_ != e_no_resume || !cmd_queue_.empty();
+					});
+					continue;
 				}
+				auto epoch = snapshot_epoch_;
+				++snapshot_inflight_;
+				lock.unlock();
 
+				install_snapshot_request request;
+				request.term_ = get_current_term_();
+				request.leader_id_ = raft_id_;
+				request.last_included_term_ = head.last_included_term_;
+				request.last_snapshot_index_ = head.last_included_index_;
+				request.offset_ = offset;
+				request.data_.resize((std::size_t)std::min<int64_t>(
+					snapshot_chunk_bytes_, file_size - offset));
+				file.clear();
+				file.seekg(offset, std::ios::beg);
+				file.read((char*)request.data_.data(), request.data_.size());
+				request.data_.resize((std::size_t)file.gcount());
+				offset += request.data_.size();
+				request.done_ = offset >= file_size;
+				done_sent = request.done_;
+				send_install_snapshot_request(request, epoch);
 			} while (!stop_);
 		}
+		//send the rest of the file over the snapshot channel, the chunked
+		//path picks up from the returned offset if it fails.
+		int64_t stream_snapshot(const snapshot_head &head, 
+			const std::string &filepath, int64_t offset, int64_t file_size)
+		{
+			snapshot_stream_head stream_head;
+			stream_head.term_ = get_current_term_();
+			stream_head.last_snapshot_index_ = head.last_included_index_;
+			stream_head.offset_ = offset;
+			stream_head.length_ = file_size - offset;
+			try
+			{
+				boost::asio::ip::tcp::endpoint endpoint(endpoint_.address(),
+					(uint16_t)(endpoint_.port() + snapshot_channel_port_offset_));
+				auto bytes_stored = send_snapshot_stream(endpoint, stream_head, filepath);
+				if (bytes_stored >= 0)
+					return bytes_stored;
+			}
+			catch (std::exception &e)
+			{
+				std::cout << e.what() << std::endl;
+			}
+			return offset;
+		}
+		//an empty chunk at offset 0 returns how much the follower has.
+		int64_t probe_snapshot(const snapshot_head &head)
+		{
+			install_snapshot_request request;
+			request.term_ = get_current_term_();
+			request.leader_id_ = raft_id_;
+			request.last_included_term_ = head.last_included_term_;
+			request.last_snapshot_index_ = head.last_included_index_;
+			auto resp = rpc_client_.call(endpoint_, RPC::install_snapshot, request);
+			if (resp.term_ > request.term_)
+			{
+				new_term_callback_(resp.term_);
+				return -1;
+			}
+			return resp.bytes_stored_;
+		}
+		void send_install_snapshot_request(const install_snapshot_request &req, uint64_t epoch)
+		{
+			auto term = req.term_;
+			auto end = req.offset_ + (int64_t)req.data_.size();
+			async_rpc_client_.call(endpoint_, RPC::install_snapshot, req)
+				.on_ok([this, epoch, term, end](auto const& resp)
+			{
+				std::unique_lock<std::mutex> lock(mtx_);
+				if (epoch != snapshot_epoch_)
+					return;
+				if (resp.term_ > term)
+				{
+					++snapshot_epoch_;
+					lock.unlock();
+					new_term_callback_(resp.term_);
+					return;
+				}
+				--snapshot_inflight_;
+				//the follower did not take the chunk, go back to what it has.
+				if (resp.bytes_stored_ < end)
+					rollback_snapshot(resp.bytes_stored_);
+				cv_.notify_one();
+			})
+				.on_error([this, epoch](auto const& e)
+			{
+				std::cout << e.get_error_message() << std::endl;
+				utils::lock_guard lock(mtx_);
+				if (epoch != snapshot_epoch_)
+					return;
+				rollback_snapshot(e_probe);
+				cv_.notify_one();
+			});
+		}
+		void rollback_snapshot(int64_t offset)
+		{
+			++snapshot_epoch_;
+			snapshot_inflight_ = 0;
+			snapshot_resume_ = offset;
+		}
 		int64_t next_heartbeat_delay()
 		{
 			auto delay = high_resolution_clock::now() - last_heart_beat_;
@@ -232,7 +555,10 @@ namespace detail
 				do_election();
 				break;
 			case cmd_t::e_append_entries:
-				do_append_entries();
+				if (pipeline_window_ > 1)
+					do_pipeline_append_entries();
+				else
+					do_append_entries();
 				break;
 			case cmd_t::e_exit:
 				do_exist();
@@ -253,7 +579,24 @@ namespace detail
 					[this] { return get_last_log_index_() != match_index_; });
 			}
 		}
+		//the leader's idle wait, a read round ends it early.
+		void wait_heartbeat(int64_t milliseconds)
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			cv_.wait_for(lock, std::chrono::milliseconds(milliseconds), [this] { 
+				return get_last_log_index_() != match_index_ || 
+					read_round_pending() || !cmd_queue_.empty(); });
+		}
 		
+		static int64_t steady_now()
+		{
+			return duration_cast<milliseconds>(
+				steady_clock::now().time_since_epoch()).count();
+		}
+		bool read_round_pending()
+		{
+			return read_round_ > read_round_sent_;
+		}
 		void update_heartbeat_time()
 		{
 			last_heart_beat_ = high_resolution_clock::now();
@@ -287,11 +630,13 @@ namespace detail
 		}
 		std::int64_t heatbeat_inteval_ = 1000;
 		using sync_client = timax::rpc::sync_client<timax::rpc::msgpack_codec>;
+		using async_client = timax::rpc::async_client<timax::rpc::msgpack_codec>;
 
 		boost::asio::ip::tcp::endpoint endpoint_;
 		sync_client rpc_client_;
+		async_client async_rpc_client_;
 		high_resolution_clock::time_point last_heart_beat_;
-		bool stop_ = false;
+		std::atomic_bool stop_{ false };
 		std::mutex mtx_;
 		std::condition_variable cv_;
 
@@ -300,6 +645,19 @@ namespace detail
 		//ratf info
 		int64_t match_index_ = 0;
 		int64_t next_index_ = 0;
+		std::size_t inflight_ = 0;
+		uint64_t pipeline_epoch_ = 0;
+		enum : int64_t
+		{
+			e_no_resume = -1,
+			e_probe = -2,
+		};
+		std::size_t snapshot_inflight_ = 0;
+		uint64_t snapshot_epoch_ = 0;
+		int64_t snapshot_resume_ = e_no_resume;
+
+		std::atomic<uint64_t> read_round_{ 0 };
+		uint64_t read_round_sent_ = 0;
 
 		bool send_heartbeat_ = false;
 		cmd_t cmd_;
@@ -27,7 +27,8 @@ namespace xraft
 			enum type
 			{
 				e_append_log,
-				e_configuration
+				e_configuration,
+				e_noop
 			};
 			int64_t index_ = 0;
 			int64_t term_ = 0;
@@ -105,6 +106,38 @@ namespace xraft
 			std::string raftlog_base_path_;
 			std::string snapshot_base_path_;
 			std::string metadata_base_path_;
+			//raft log group commit, 0 bytes disables it.
+			std::size_t group_commit_max_bytes_ = 0;
+			int64_t group_commit_max_wait_us_ = 0;
+			//memory budget of the in-memory raft log tail.
+			std::size_t log_cache_max_bytes_ = 16 * 1024 * 1024;
+			//leader persists its own entries in parallel with replication,
+			//off unless a deployment opts in.
+			bool async_log_persist_ = false;
+			//in-flight AppendEntries per follower, 1 sends them one by one.
+			std::size_t append_entries_pipeline_window_ = 1;
+			//proposal batching in front of raft::replicate, 0 bytes disables it.
+			std::size_t propose_batch_max_bytes_ = 0;
+			int64_t propose_batch_max_wait_us_ = 0;
+			//granularity of the timing wheel behind the raft timers.
+			int64_t timer_tick_ms_ = 10;
+			//how often lazily updated committed/applied indexes are synced.
+			int64_t hard_state_flush_interval_ms_ = 100;
+			//InstallSnapshot chunk size and chunks in flight per follower.
+			std::size_t snapshot_chunk_bytes_ = 1024 * 1024;
+			std::size_t snapshot_window_ = 4;
+			//snapshot files are streamed with sendfile on rpc port + offset,
+			//0 sends them through InstallSnapshot chunks only.
+			int snapshot_channel_port_offset_ = 0;
+			//minimum time between the starts of two snapshot builds.
+			int64_t snapshot_min_interval_ms_ = 10000;
+			//snapshot_codecs id, e_none writes the raw format.
+			uint32_t snapshot_codec_ = 0;
+			std::size_t snapshot_block_bytes_ = 64 * 1024;
+			//leader lease reads: no heartbeat round while a majority acked
+			//within election_timeout_ - lease_clock_drift_ms_.
+			bool lease_read_ = false;
+			int64_t lease_clock_drift_ms_ = 100;
 		};
 		struct append_entries_request
 		{
@@ -158,5 +191,25 @@ namespace xraft
 
 			META(term_, bytes_stored_);
 		};
+
+		//a follower asks the leader for a read index to serve a read.
+		struct read_index_request
+		{
+			int64_t term_ = 0;
+			std::string follower_id_;
+			uint64_t request_id_ = 0;
+
+			META(term_, follower_id_, request_id_);
+		};
+
+		struct read_index_response
+		{
+			int64_t term_ = 0;
+			bool success_ = false;
+			int64_t index_ = 0;
+			uint64_t request_id_ = 0;
+
+			META(term_, success_, index_, request_id_);
+		};
 	}
 }
\ No newline at end of file
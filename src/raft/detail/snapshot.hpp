@@ -3,12 +3,22 @@ namespace xraft
 {
 	namespace detail
 	{
+		//version 1 is followed by the raw state machine bytes, version 2 by
+		//blocks compressed with codec_, see snapshot_block_frame.
 		struct snapshot_head
 		{
-			uint32_t version_ = 1;
+			enum : uint32_t
+			{
+				e_raw_version = 1,
+				e_block_version = 2,
+				e_raw_size = sizeof(uint32_t) * 2 + sizeof(int64_t) * 2,
+				e_block_size = e_raw_size + sizeof(uint32_t),
+			};
+			uint32_t version_ = e_raw_version;
 			uint32_t magic_num_ = 'X'+'R'+'A'+'F'+'T';
 			int64_t last_included_index_;
 			int64_t last_included_term_;
+			uint32_t codec_ = snapshot_codecs::e_none;
 		};
 		class snapshot_reader
 		{
@@ -29,26 +39,60 @@ namespace xraft
 			bool read_sanpshot_head(snapshot_head &head)
 			{
 				std::string buffer;
-				buffer.resize(sizeof(head));
+				buffer.resize(snapshot_head::e_block_size);
+				file_.clear();
 				file_.seekg(0, std::ios::beg);
-				file_.read((char*)buffer.data(), buffer.size());
-				if (file_.gcount() != buffer.size())
+				file_.read((char*)buffer.data(), snapshot_head::e_raw_size);
+				if (file_.gcount() != snapshot_head::e_raw_size)
 					return false;
 				unsigned char *ptr = (unsigned char*)buffer.data();
-				if (endec::get_uint32(ptr) != head.version_ || 
+				head.version_ = endec::get_uint32(ptr);
+				if ((head.version_ != snapshot_head::e_raw_version &&
+					head.version_ != snapshot_head::e_block_version) ||
 					endec::get_uint32(ptr) != head.magic_num_)
 					return false;
 				head.last_included_index_ = (int64_t)endec::get_uint64(ptr);
 				head.last_included_term_ = (int64_t)endec::get_uint64(ptr);
+				head.codec_ = snapshot_codecs::e_none;
+				stream_.reset();
+				streambuf_.reset();
+				if (head.version_ == snapshot_head::e_raw_version)
+					return true;
+
+				file_.read((char*)ptr, sizeof(uint32_t));
+				if (file_.gcount() != sizeof(uint32_t))
+					return false;
+				head.codec_ = endec::get_uint32(ptr);
+				auto codec = snapshot_codecs::get(head.codec_);
+				if (!codec)
+				{
+					std::cout << "unknown snapshot codec " << head.codec_ << std::endl;
+					return false;
+				}
+				streambuf_.reset(new snapshot_block_streambuf(file_, codec));
+				stream_.reset(new std::istream(streambuf_.get()));
+				//a corrupted block throws out of the reads instead of
+				//looking like the end of the snapshot.
+				stream_->exceptions(std::ios::badbit);
 				return true;
 			}
-			std::ifstream &get_snapshot_stream()
+			//the state machine bytes after the head, uncompressed.
+			std::istream &get_snapshot_stream()
+			{
+				if (stream_)
+					return *stream_;
+				return file_;
+			}
+			//the file as it is stored and sent to peers.
+			std::ifstream &get_file_stream()
 			{
 				return file_;
 			}
 		private:
 			std::string filepath_;
 			std::ifstream file_;
+			std::unique_ptr<snapshot_block_streambuf> streambuf_;
+			std::unique_ptr<std::istream> stream_;
 		};
 		class snapshot_writer
 		{
@@ -72,26 +116,71 @@ namespace xraft
 			}
 			void close()
 			{
+				codec_.reset();
+				block_.clear();
 				if(file_.is_open())
 					file_.close();
 			}
 			bool write_sanpshot_head(const snapshot_head &head)
 			{
 				std::string buffer;
-				buffer.resize(sizeof(head));
+				buffer.resize(head.version_ == snapshot_head::e_block_version ?
+					snapshot_head::e_block_size : snapshot_head::e_raw_size);
 				unsigned char *ptr = (unsigned char*)buffer.data();
 				endec::put_uint32(ptr, head.version_);
 				endec::put_uint32(ptr, head.magic_num_);
 				endec::put_uint64(ptr, (uint64_t)head.last_included_index_);
 				endec::put_uint64(ptr, (uint64_t)head.last_included_term_);
+				if (head.version_ == snapshot_head::e_block_version)
+					endec::put_uint32(ptr, head.codec_);
 				assert(buffer.size() == ptr - (unsigned char*)buffer.data());
-				return write(buffer);
+				if (!write(buffer))
+					return false;
+				if (head.version_ == snapshot_head::e_block_version)
+				{
+					codec_ = snapshot_codecs::get(head.codec_);
+					if (!codec_)
+						return false;
+				}
+				return true;
+			}
+			//compress what follows the head in blocks of block_bytes.
+			void set_block_bytes(std::size_t block_bytes)
+			{
+				block_bytes_ = std::max<std::size_t>(block_bytes, 1);
 			}
+			//buffered, call sync once the snapshot is complete.
 			bool write(const std::string &buffer)
 			{
-				file_.write(buffer.data(), buffer.size());
+				return write(buffer.data(), buffer.size());
+			}
+			bool write(const char *data, std::size_t size)
+			{
+				if (!codec_)
+				{
+					file_.write(data, size);
+					return file_.good();
+				}
+				block_.append(data, size);
+				std::size_t pos = 0;
+				for (; block_.size() - pos >= block_bytes_; pos += block_bytes_)
+				{
+					if (!write_block(block_.data() + pos, block_bytes_))
+						return false;
+				}
+				block_.erase(0, pos);
+				return true;
+			}
+			bool sync()
+			{
+				if (codec_ && block_.size())
+				{
+					if (!write_block(block_.data(), block_.size()))
+						return false;
+					block_.clear();
+				}
 				file_.flush();
-				return file_.good();
+				return file_.good() && functors::fs::fdatasync()(filepath_);
 			}
 			void discard()
 			{
@@ -107,8 +196,28 @@ namespace xraft
 				return filepath_;
 			}
 		private:
+			bool write_block(const char *data, std::size_t size)
+			{
+				codec_->compress(data, size, compressed_);
+				//blocks that do not shrink are stored as they are.
+				if (compressed_.size() >= size)
+					compressed_.assign(data, size);
+				std::string frame(snapshot_block_frame::size, '\0');
+				unsigned char *ptr = (unsigned char*)&frame[0];
+				endec::put_uint32(ptr, (uint32_t)size);
+				endec::put_uint32(ptr, (uint32_t)compressed_.size());
+				endec::put_uint32(ptr, snapshot_block_frame::checksum(
+					compressed_.data(), compressed_.size()));
+				file_.write(frame.data(), frame.size());
+				file_.write(compressed_.data(), compressed_.size());
+				return file_.good();
+			}
 			std::string filepath_;
 			std::ofstream file_;
+			std::shared_ptr<snapshot_codec> codec_;
+			std::size_t block_bytes_ = 64 * 1024;
+			std::string block_;
+			std::string compressed_;
 		};
 		class snapshot_builder
 		{
@@ -116,6 +225,7 @@ namespace xraft
 			using get_applied_index_handle = std::function<int64_t()>;
 			using build_snapshot_callback = std::function<bool(const std::function<bool(const std::string &)>&, int64_t)>;
 			using build_snapshot_done_callback = std::function<void(int64_t)>;
+			using build_snapshot_failed_callback = std::function<void(int64_t)>;
 			using get_log_entry_term_handle = std::function<int64_t(int64_t)>;
 
 			snapshot_builder()
@@ -144,47 +254,101 @@ namespace xraft
 			{
 				build_snapshot_done_ = callback;
 			}
+			void regist_build_snapshot_failed_callback(const build_snapshot_failed_callback &callback)
+			{
+				build_snapshot_failed_ = callback;
+			}
+			//snapshot_codecs::e_none keeps the raw format.
+			void set_codec(uint32_t codec, std::size_t block_bytes)
+			{
+				codec_ = codec;
+				block_bytes_ = block_bytes;
+			}
 			void make_snapshot()
 			{
-				do_make_snapshot();
+				do_make_snapshot(get_applied_index_());
+			}
+			//index must be the applied index the state machine view was taken at.
+			void make_snapshot(int64_t index)
+			{
+				do_make_snapshot(index);
 			}
 		private:
-			void do_make_snapshot()
+			void do_make_snapshot(int64_t index)
 			{
 				snapshot_writer writer;
 				snapshot_head head;
 
-				auto index= get_applied_index_();
 				head.last_included_index_ = index;
 				head.last_included_term_ = get_log_entry_term_(index);
+				if (codec_ != snapshot_codecs::e_none)
+				{
+					head.version_ = snapshot_head::e_block_version;
+					head.codec_ = codec_;
+					writer.set_block_bytes(block_bytes_);
+				}
 				
 				std::string filepath = snapshot_base_path_ + std::to_string(index) + ".ss";
 
-				if (!writer.open(filepath))
-					throw std::runtime_error("open "+filepath+ "error");
-
-				writer.write_sanpshot_head(head);
-				auto result = build_snapshot_([&writer](const std::string &buffer)
-				{
-					writer.write(buffer);
-					return true;
-				}, index);
-
-				if (result == false)
+				//the log prefix is only dropped for a durable snapshot.
+				if (!write_snapshot(writer, head, filepath, index))
 				{
-					std::cout << "build_snapshot_ failed" << std::endl;
 					writer.discard();
+					if (build_snapshot_failed_)
+						build_snapshot_failed_(index);
+					return;
 				}
 				writer.close();
 
 				build_snapshot_done_(index);
 				//todo log snapshot done
 			}
+			bool write_snapshot(snapshot_writer &writer, const snapshot_head &head,
+				const std::string &filepath, int64_t index)
+			{
+				try
+				{
+					if (!writer.open(filepath))
+					{
+						std::cout << "open " << filepath << " error" << std::endl;
+						return false;
+					}
+					if (!writer.write_sanpshot_head(head))
+					{
+						std::cout << "write " << filepath << " head error" << std::endl;
+						return false;
+					}
+					auto result = build_snapshot_([&writer](const std::string &buffer)
+					{
+						writer.write(buffer);
+						return true;
+					}, index);
+					if (result == false)
+					{
+						std::cout << "build_snapshot_ failed" << std::endl;
+						return false;
+					}
+					if (!writer.sync())
+					{
+						std::cout << "sync snapshot failed" << std::endl;
+						return false;
+					}
+				}
+				catch (std::exception &e)
+				{
+					std::cout << "build snapshot error: " << e.what() << std::endl;
+					return false;
+				}
+				return true;
+			}
 			std::string snapshot_base_path_;
 			get_log_entry_term_handle get_log_entry_term_;
 			get_applied_index_handle get_applied_index_;
 			build_snapshot_callback build_snapshot_;
 			build_snapshot_done_callback build_snapshot_done_;
+			build_snapshot_failed_callback build_snapshot_failed_;
+			uint32_t codec_ = snapshot_codecs::e_none;
+			std::size_t block_bytes_ = 64 * 1024;
 			bool is_stop_ = false;
 			int64_t distance_ = 10000;
 			std::thread worker_;
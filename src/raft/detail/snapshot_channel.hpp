@@ -0,0 +1,244 @@
+#pragma once
+#ifdef _MSC_VER
+#include <mswsock.h>
+#pragma comment(lib, "Mswsock.lib")
+#elif defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+namespace xraft
+{
+namespace detail
+{
+	//raw byte stream for snapshot files, next to the rpc port.
+	//the sender hands the file to the kernel (sendfile/TransmitFile),
+	//the receiver writes the socket bytes to the snapshot file.
+	//a stream is: head, int64 bytes_stored back (the stream goes on only
+	//when it equals head.offset_), length bytes, int64 bytes_stored back.
+	struct snapshot_stream_head
+	{
+		int64_t term_ = 0;
+		int64_t last_snapshot_index_ = 0;
+		int64_t offset_ = 0;
+		int64_t length_ = 0;
+
+		enum { size = sizeof(int64_t) * 4 };
+		std::string to_string() const
+		{
+			std::string buffer(size, '\0');
+			unsigned char *ptr = (unsigned char*)buffer.data();
+			endec::put_uint64(ptr, (uint64_t)term_);
+			endec::put_uint64(ptr, (uint64_t)last_snapshot_index_);
+			endec::put_uint64(ptr, (uint64_t)offset_);
+			endec::put_uint64(ptr, (uint64_t)length_);
+			return buffer;
+		}
+		void from_string(std::string &buffer)
+		{
+			unsigned char *ptr = (unsigned char*)buffer.data();
+			term_ = (int64_t)endec::get_uint64(ptr);
+			last_snapshot_index_ = (int64_t)endec::get_uint64(ptr);
+			offset_ = (int64_t)endec::get_uint64(ptr);
+			length_ = (int64_t)endec::get_uint64(ptr);
+		}
+	};
+
+	class snapshot_channel_server
+	{
+	public:
+		using socket_t = boost::asio::ip::tcp::socket;
+		//replies the bytes stored before reading any data, then returns
+		//the bytes stored after the stream or -1 when it was rejected.
+		using stream_handle = std::function<int64_t(const snapshot_stream_head &, socket_t &)>;
+
+		snapshot_channel_server()
+			:acceptor_(io_service_)
+		{
+
+		}
+		~snapshot_channel_server()
+		{
+			stop();
+		}
+		void regist_stream_handle(const stream_handle &handle)
+		{
+			stream_handle_ = handle;
+		}
+		//a sender quiet for this long is dropped.
+		void set_timeout(int64_t milliseconds)
+		{
+			timeout_ms_ = milliseconds;
+		}
+		int64_t get_timeout()
+		{
+			return timeout_ms_;
+		}
+		//read_some that throws once timeout_ms passes with no data.
+		//asio's blocking reads ignore SO_RCVTIMEO, so the socket is
+		//switched to non-blocking and waited on with select.
+		static std::size_t read_some(socket_t &socket, char *data, std::size_t size, 
+			int64_t timeout_ms)
+		{
+			socket.non_blocking(true);
+			for (;;)
+			{
+				boost::system::error_code ec;
+				auto bytes = socket.read_some(boost::asio::buffer(data, size), ec);
+				if (!ec)
+					return bytes;
+				if (ec != boost::asio::error::would_block && ec != boost::asio::error::try_again)
+					throw boost::system::system_error(ec);
+				auto fd = socket.native_handle();
+				fd_set fds;
+				FD_ZERO(&fds);
+				FD_SET(fd, &fds);
+				timeval tv;
+				tv.tv_sec = (long)(timeout_ms / 1000);
+				tv.tv_usec = (long)(timeout_ms % 1000 * 1000);
+				auto ready = ::select((int)fd + 1, &fds, nullptr, nullptr, &tv);
+				if (ready == 0)
+					throw std::runtime_error("snapshot stream timeout");
+				//winsock reports its errors through WSAGetLastError, not errno.
+#ifdef _MSC_VER
+				if (ready == SOCKET_ERROR && WSAGetLastError() != WSAEINTR)
+#else
+				if (ready < 0 && errno != EINTR)
+#endif
+					throw std::runtime_error("snapshot stream select failed");
+			}
+		}
+		static void reply(socket_t &socket, int64_t bytes_stored)
+		{
+			std::string buffer(sizeof(int64_t), '\0');
+			unsigned char *ptr = (unsigned char*)&buffer[0];
+			endec::put_uint64(ptr, (uint64_t)bytes_stored);
+			boost::asio::write(socket, boost::asio::buffer(buffer));
+		}
+		void start(uint16_t port)
+		{
+			using namespace boost::asio::ip;
+			tcp::endpoint endpoint(tcp::v4(), port);
+			acceptor_.open(endpoint.protocol());
+			acceptor_.set_option(tcp::acceptor::reuse_address(true));
+			acceptor_.bind(endpoint);
+			acceptor_.listen();
+			do_accept();
+			worker_ = std::thread([this] { io_service_.run(); });
+		}
+		void stop()
+		{
+			io_service_.stop();
+			if (worker_.joinable())
+				worker_.join();
+		}
+	private:
+		void do_accept()
+		{
+			auto socket = std::make_shared<socket_t>(io_service_);
+			acceptor_.async_accept(*socket, [this, socket](const boost::system::error_code &ec)
+			{
+				if (ec)
+					return;
+				//one stream at a time, it owns the worker until done.
+				handle_stream(*socket);
+				do_accept();
+			});
+		}
+		void handle_stream(socket_t &socket)
+		{
+			try
+			{
+				std::string buffer(snapshot_stream_head::size, '\0');
+				std::size_t bytes = 0;
+				while (bytes < buffer.size())
+					bytes += read_some(socket, &buffer[bytes], buffer.size() - bytes, timeout_ms_);
+				snapshot_stream_head head;
+				head.from_string(buffer);
+				int64_t bytes_stored = stream_handle_(head, socket);
+				if (bytes_stored >= 0)
+					reply(socket, bytes_stored);
+			}
+			catch (std::exception &e)
+			{
+				std::cout << "snapshot stream error: " << e.what() << std::endl;
+			}
+		}
+		boost::asio::io_service io_service_;
+		boost::asio::ip::tcp::acceptor acceptor_;
+		stream_handle stream_handle_;
+		int64_t timeout_ms_ = 10000;
+		std::thread worker_;
+	};
+
+	//send [head.offset_, head.offset_ + head.length_) of filepath,
+	//returns what the receiver has stored.
+	inline int64_t send_snapshot_stream(const boost::asio::ip::tcp::endpoint &endpoint,
+		const snapshot_stream_head &head, const std::string &filepath)
+	{
+		boost::asio::io_service io_service;
+		boost::asio::ip::tcp::socket socket(io_service);
+		socket.connect(endpoint);
+		boost::asio::write(socket, boost::asio::buffer(head.to_string()));
+		auto read_reply = [&socket] {
+			std::string reply(sizeof(int64_t), '\0');
+			boost::asio::read(socket, boost::asio::buffer(&reply[0], reply.size()));
+			unsigned char *ptr = (unsigned char*)&reply[0];
+			return (int64_t)endec::get_uint64(ptr);
+		};
+		auto bytes_stored = read_reply();
+		if (bytes_stored != head.offset_)
+			return bytes_stored;
+
+		int64_t offset = head.offset_;
+		int64_t remain = head.length_;
+#ifdef _MSC_VER
+		HANDLE file = CreateFile(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ,
+			NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("open " + filepath + " failed");
+		utils::guard close_file([file] { CloseHandle(file); });
+		while (remain > 0)
+		{
+			//TransmitFile sends at most 2GB - 1 per call.
+			DWORD bytes = (DWORD)std::min<int64_t>(remain, 0x7fffffff);
+			LARGE_INTEGER pos;
+			pos.QuadPart = offset;
+			if (!SetFilePointerEx(file, pos, NULL, FILE_BEGIN) ||
+				!TransmitFile(socket.native_handle(), file, bytes, 0, NULL, NULL, 0))
+				throw std::runtime_error("TransmitFile " + filepath + " failed");
+			offset += bytes;
+			remain -= bytes;
+		}
+#else
+		int fd = ::open(filepath.c_str(), O_RDONLY);
+		if (fd == -1)
+			throw std::runtime_error("open " + filepath + " failed");
+		utils::guard close_file([fd] { ::close(fd); });
+#if defined(__linux__)
+		off_t file_offset = (off_t)offset;
+		while (remain > 0)
+		{
+			auto bytes = ::sendfile(socket.native_handle(), fd, &file_offset, (std::size_t)remain);
+			if (bytes == -1 && errno == EINTR)
+				continue;
+			if (bytes <= 0)
+				throw std::runtime_error("sendfile " + filepath + " failed");
+			remain -= bytes;
+		}
+#else
+		std::string buffer(256 * 1024, '\0');
+		while (remain > 0)
+		{
+			auto bytes = ::pread(fd, &buffer[0],
+				(std::size_t)std::min<int64_t>(remain, buffer.size()), (off_t)offset);
+			if (bytes <= 0)
+				throw std::runtime_error("read " + filepath + " failed");
+			boost::asio::write(socket, boost::asio::buffer(buffer.data(), (std::size_t)bytes));
+			offset += bytes;
+			remain -= bytes;
+		}
+#endif
+#endif
+		return read_reply();
+	}
+}
+}
\ No newline at end of file
@@ -0,0 +1,245 @@
+#pragma once
+namespace xraft
+{
+namespace detail
+{
+	//compresses one snapshot block, the codec id is kept in the snapshot head.
+	class snapshot_codec
+	{
+	public:
+		virtual ~snapshot_codec() {}
+		virtual void compress(const char *data, std::size_t size, std::string &out) = 0;
+		//false when the block is corrupted.
+		virtual bool uncompress(const char *data, std::size_t size,
+			std::size_t raw_size, std::string &out) = 0;
+	};
+
+	//small lz77 codec, no dependency. a block is a list of
+	//(literal length, literals, match length, match offset) with varint
+	//lengths, the last one has no match.
+	class lz_snapshot_codec : public snapshot_codec
+	{
+	public:
+		void compress(const char *data, std::size_t size, std::string &out) override
+		{
+			std::vector<int64_t> table(hash_size, -1);
+			out.clear();
+			out.reserve(size / 2);
+			std::size_t anchor = 0;
+			std::size_t pos = 0;
+			while (pos + min_match <= size)
+			{
+				auto &slot = table[hash(data + pos)];
+				auto candidate = slot;
+				slot = (int64_t)pos;
+				if (candidate < 0 || memcmp(data + candidate, data + pos, min_match))
+				{
+					++pos;
+					continue;
+				}
+				std::size_t length = min_match;
+				while (pos + length < size && data[candidate + length] == data[pos + length])
+					++length;
+				put_varint(out, pos - anchor);
+				out.append(data + anchor, pos - anchor);
+				put_varint(out, length);
+				put_varint(out, pos - (std::size_t)candidate);
+				pos += length;
+				anchor = pos;
+			}
+			put_varint(out, size - anchor);
+			out.append(data + anchor, size - anchor);
+			put_varint(out, 0);
+		}
+		bool uncompress(const char *data, std::size_t size,
+			std::size_t raw_size, std::string &out) override
+		{
+			out.clear();
+			out.reserve(raw_size);
+			const char *end = data + size;
+			while (data < end)
+			{
+				uint64_t literals = 0, length = 0, offset = 0;
+				if (!get_varint(data, end, literals) || (uint64_t)(end - data) < literals)
+					return false;
+				out.append(data, (std::size_t)literals);
+				data += literals;
+				if (!get_varint(data, end, length))
+					return false;
+				if (length == 0)
+					break;
+				if (!get_varint(data, end, offset) || offset == 0 || offset > out.size())
+					return false;
+				//the match may overlap the bytes it produces.
+				auto from = out.size() - (std::size_t)offset;
+				for (uint64_t i = 0; i < length; ++i)
+					out.push_back(out[from + (std::size_t)i]);
+			}
+			return data == end && out.size() == raw_size;
+		}
+	private:
+		enum
+		{
+			min_match = 4,
+			hash_bits = 14,
+			hash_size = 1 << hash_bits,
+		};
+		static std::size_t hash(const char *data)
+		{
+			uint32_t value;
+			memcpy(&value, data, sizeof(value));
+			return (value * 2654435761u) >> (32 - hash_bits);
+		}
+		static void put_varint(std::string &out, uint64_t value)
+		{
+			while (value >= 0x80)
+			{
+				out.push_back((char)(value | 0x80));
+				value >>= 7;
+			}
+			out.push_back((char)value);
+		}
+		static bool get_varint(const char *&data, const char *end, uint64_t &value)
+		{
+			value = 0;
+			for (int shift = 0; data < end && shift < 64; shift += 7)
+			{
+				auto byte = (uint8_t)*data++;
+				value |= (uint64_t)(byte & 0x7f) << shift;
+				if (!(byte & 0x80))
+					return true;
+			}
+			return false;
+		}
+	};
+
+	//codec ids are stored in snapshots, never reuse one.
+	class snapshot_codecs
+	{
+	public:
+		enum : uint32_t
+		{
+			e_none = 0,
+			e_lz = 1,
+		};
+		static void regist(uint32_t id, const std::shared_ptr<snapshot_codec> &codec)
+		{
+			std::lock_guard<std::mutex> lock(get_mutex());
+			get_codecs()[id] = codec;
+		}
+		static std::shared_ptr<snapshot_codec> get(uint32_t id)
+		{
+			std::lock_guard<std::mutex> lock(get_mutex());
+			auto &codecs = get_codecs();
+			auto itr = codecs.find(id);
+			if (itr == codecs.end())
+				return nullptr;
+			return itr->second;
+		}
+	private:
+		static std::mutex &get_mutex()
+		{
+			static std::mutex mtx;
+			return mtx;
+		}
+		static std::map<uint32_t, std::shared_ptr<snapshot_codec>> &get_codecs()
+		{
+			static std::map<uint32_t, std::shared_ptr<snapshot_codec>> codecs = {
+				{ e_lz, std::make_shared<lz_snapshot_codec>() },
+			};
+			return codecs;
+		}
+	};
+
+	//a block is framed as raw size, stored size, checksum of the stored bytes.
+	struct snapshot_block_frame
+	{
+		enum { size = sizeof(uint32_t) * 3 };
+		//fnv-1a
+		static uint32_t checksum(const char *data, std::size_t size)
+		{
+			uint32_t hash = 2166136261u;
+			for (std::size_t i = 0; i < size; ++i)
+			{
+				hash ^= (uint8_t)data[i];
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+	};
+
+	//reads the framed blocks after the snapshot head and hands out the
+	//uncompressed bytes, one block in memory at a time. seeking works
+	//inside the current block, which is enough to peek at a header.
+	class snapshot_block_streambuf : public std::streambuf
+	{
+	public:
+		snapshot_block_streambuf(std::istream &file, const std::shared_ptr<snapshot_codec> &codec)
+			:file_(file),
+			codec_(codec)
+		{
+			setg(nullptr, nullptr, nullptr);
+		}
+	protected:
+		int_type underflow() override
+		{
+			if (gptr() < egptr())
+				return traits_type::to_int_type(*gptr());
+			if (!read_block())
+				return traits_type::eof();
+			return traits_type::to_int_type(*gptr());
+		}
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+			std::ios_base::openmode which) override
+		{
+			if (dir != std::ios_base::cur)
+				return pos_type(off_type(-1));
+			return seekpos(pos_type(block_pos_ + (gptr() - eback()) + off), which);
+		}
+		pos_type seekpos(pos_type pos, std::ios_base::openmode) override
+		{
+			off_type offset = off_type(pos) - block_pos_;
+			if (offset < 0 || offset > egptr() - eback())
+				return pos_type(off_type(-1));
+			setg(eback(), eback() + offset, egptr());
+			return pos;
+		}
+	private:
+		bool read_block()
+		{
+			std::string frame(snapshot_block_frame::size, '\0');
+			file_.read(&frame[0], frame.size());
+			if (file_.gcount() == 0)
+				return false;
+			if ((std::size_t)file_.gcount() != frame.size())
+				throw std::runtime_error("snapshot block frame truncated");
+			unsigned char *ptr = (unsigned char*)&frame[0];
+			auto raw_size = endec::get_uint32(ptr);
+			auto stored_size = endec::get_uint32(ptr);
+			auto checksum = endec::get_uint32(ptr);
+			stored_.resize(stored_size);
+			file_.read(&stored_[0], stored_size);
+			if ((uint32_t)file_.gcount() != stored_size)
+				throw std::runtime_error("snapshot block truncated");
+			if (snapshot_block_frame::checksum(stored_.data(), stored_.size()) != checksum)
+				throw std::runtime_error("snapshot block checksum mismatch");
+
+			block_pos_ += block_.size();
+			//blocks that did not shrink are stored as they are.
+			if (stored_size == raw_size)
+				block_.swap(stored_);
+			else if (!codec_->uncompress(stored_.data(), stored_.size(), raw_size, block_))
+				throw std::runtime_error("snapshot block corrupted");
+			if (block_.empty())
+				return false;
+			setg(&block_[0], &block_[0], &block_[0] + block_.size());
+			return true;
+		}
+		std::istream &file_;
+		std::shared_ptr<snapshot_codec> codec_;
+		std::string stored_;
+		std::string block_;
+		int64_t block_pos_ = 0;
+	};
+}
+}
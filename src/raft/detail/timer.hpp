@@ -4,77 +4,136 @@ namespace xraft
 	namespace detail
 	{
 		using namespace std::chrono;
+		//hashed timing wheel, set_timer and cancel are O(1).
+		//timeouts are rounded up to the tick.
 		class timer
 		{
 		public:
-			timer()
-				
+			timer(int64_t tick_ms = 10, std::size_t slots = 1024)
 			{
-				
+				set_tick(tick_ms, slots);
 			}
 			~timer()
 			{
 				stop();
+				if (checker_.joinable())
+					checker_.join();
+			}
+			//call before any timer is set.
+			void set_tick(int64_t tick_ms, std::size_t slots = 1024)
+			{
+				utils::lock_guard lock(mtx_);
+				std::size_t size = 1;
+				while (size < slots)
+					size <<= 1;
+				tick_ = milliseconds(tick_ms > 0 ? tick_ms : 1);
+				wheel_.clear();
+				wheel_.resize(size);
+				timers_.clear();
+				start_point_ = high_resolution_clock::now();
+				processed_tick_ = 0;
 			}
 			int64_t set_timer(int64_t timeout, std::function<void()> &&callback)
 			{
 				utils::lock_guard lock(mtx_);
-				auto timer_point = high_resolution_clock::now()
-					+ high_resolution_clock::duration(milliseconds(timeout));
+				auto now = current_tick();
+				if (timers_.empty())
+					processed_tick_ = now;
+				auto ticks = (milliseconds(timeout) + tick_ - high_resolution_clock::duration(1)) / tick_;
+				auto expire_tick = now + (ticks > 0 ? ticks : 1);
 				auto timer_id = gen_timer_id();
-				actions_.emplace(std::piecewise_construct, 
-					std::forward_as_tuple(timer_point), 
-					std::forward_as_tuple(timer_id,std::move(callback)));
+				auto &slot = wheel_[slot_of(expire_tick)];
+				slot.emplace_back(timer_id, expire_tick, std::move(callback));
+				timers_.emplace(timer_id, --slot.end());
 				cv_.notify_one();
 				return timer_id;
 			}
 			void cancel(int64_t timer_id)
 			{
 				utils::lock_guard lock(mtx_);
-				for (auto &itr = actions_.begin(); itr != actions_.end(); itr++)
-				{
-					if (itr->second.first == timer_id)
-					{
-						actions_.erase(itr);
-						cv_.notify_one();
-						return;
-					}
-				}
+				auto itr = timers_.find(timer_id);
+				if (itr == timers_.end())
+					return;
+				wheel_[slot_of(itr->second->expire_tick_)].erase(itr->second);
+				timers_.erase(itr);
 			}
 			void start()
 			{
 				checker_ = std::thread([this] { run(); });
-				checker_.detach();
 			}
 			void stop()
 			{
-				stop_ = false;
+				utils::lock_guard lock(mtx_);
+				stop_ = true;
 				cv_.notify_one();
 			}
 		private:
+			struct timer_node
+			{
+				timer_node(int64_t id, int64_t expire_tick, std::function<void()> &&callback)
+					:id_(id),
+					expire_tick_(expire_tick),
+					callback_(std::move(callback))
+				{
+				}
+				int64_t id_;
+				int64_t expire_tick_;
+				std::function<void()> callback_;
+			};
+			using slot_t = std::list<timer_node>;
 			void run()
 			{
+				std::unique_lock<std::mutex> lock(mtx_);
 				while (!stop_)
 				{
-					std::unique_lock<std::mutex> lock(mtx_);
-					if (actions_.empty())
+					if (timers_.empty())
 					{
 						cv_.wait_for(lock, std::chrono::milliseconds(500));
 						continue;
 					}
-					auto itr = actions_.begin();
-					auto timeout_point = itr->first;
-					if (timeout_point > high_resolution_clock::now())
+					auto now = current_tick();
+					if (now <= processed_tick_)
 					{
-						cv_.wait_until(lock, timeout_point);
+						cv_.wait_until(lock, start_point_ + tick_ * (processed_tick_ + 1));
 						continue;
 					}
-					auto action = std::move(itr->second.second);
-					actions_.erase(itr);
+					std::vector<std::function<void()>> actions;
+					expire(now, actions);
+					processed_tick_ = now;
 					lock.unlock();
-					action();
+					for (auto &action : actions)
+						action();
+					lock.lock();
 				}
 			}
+			void expire(int64_t now, std::vector<std::function<void()>> &actions)
+			{
+				//after a full turn every slot has been visited once.
+				auto ticks = std::min<int64_t>(now - processed_tick_, (int64_t)wheel_.size());
+				for (int64_t tick = now - ticks + 1; tick <= now; ++tick)
+				{
+					auto &slot = wheel_[slot_of(tick)];
+					for (auto itr = slot.begin(); itr != slot.end();)
+					{
+						if (itr->expire_tick_ > now)
+						{
+							++itr;
+							continue;
+						}
+						actions.emplace_back(std::move(itr->callback_));
+						timers_.erase(itr->id_);
+						itr = slot.erase(itr);
+					}
+				}
+			}
+			int64_t current_tick()
+			{
+				return (high_resolution_clock::now() - start_point_) / tick_;
+			}
+			std::size_t slot_of(int64_t tick)
+			{
+				return (std::size_t)tick & (wheel_.size() - 1);
+			}
 			int64_t gen_timer_id()
 			{
 				return ++timer_id_;
@@ -83,8 +142,11 @@ namespace xraft
 			std::condition_variable cv_;
 			std::mutex mtx_;
 			int64_t timer_id_ = 1;
-			std::multimap<high_resolution_clock::time_point, 
-				std::pair<int64_t, std::function<void()>>> actions_;
+			high_resolution_clock::duration tick_;
+			high_resolution_clock::time_point start_point_;
+			int64_t processed_tick_ = 0;
+			std::vector<slot_t> wheel_;
+			std::unordered_map<int64_t, slot_t::iterator> timers_;
 			std::thread checker_;
 		};
 	}
@@ -10,8 +10,12 @@ namespace xraft
 		using raft_config = detail::raft_config;
 		using append_log_callback = std::function<void(bool, int64_t)>;
 		using commit_entry_callback = std::function<void(std::string &&, int64_t)>;
-		using install_snapshot_callback = std::function<void(std::ifstream &)>;
+		using commit_entries_callback = std::function<void(std::list<log_entry> &&)>;
+		using get_applied_index_handle = std::function<int64_t()>;
+		using read_index_callback = std::function<void(bool, int64_t)>;
+		using install_snapshot_callback = std::function<void(std::istream &)>;
 		using build_snapshot_callback = std::function<bool(const std::function<bool(const std::string &)>&, int64_t)>;
+		using prepare_snapshot_callback = std::function<void(int64_t)>;
 		enum state
 		{
 			e_follower,
@@ -31,16 +35,155 @@ namespace xraft
 		}
 		void replicate(std::string &&data, append_log_callback&&callback)
 		{
-			do_relicate(std::move(data), std::move(callback));
+			std::unique_lock<std::mutex> lock(propose_mtx_);
+			if (!propose_batch_max_bytes_)
+			{
+				lock.unlock();
+				do_relicate(std::move(data), std::move(callback));
+				return;
+			}
+			proposals_bytes_ += data.size();
+			proposals_.emplace_back(std::move(data), std::move(callback));
+			//the first proposal of a batch schedules its flush.
+			if (proposals_.size() == 1)
+				proposer_.push([this] { flush_proposals(); });
+			else if (proposals_bytes_ >= propose_batch_max_bytes_)
+				propose_cv_.notify_one();
+		}
+		//linearizable read without a log write: the callback gets true and
+		//the read index once leadership is confirmed by a heartbeat round
+		//and the state machine has applied that index. concurrent calls
+		//share one round.
+		void read_index(read_index_callback &&callback)
+		{
+			confirm_read_index(std::move(callback), true);
+		}
+		//the leader's confirmed read index, without waiting for it to be
+		//applied here. a follower gets it from the leader through an rpc,
+		//then serves the read once it has applied up to the index.
+		void get_read_index(read_index_callback &&callback)
+		{
+			if (state_ == e_leader)
+			{
+				confirm_read_index(std::move(callback), false);
+				return;
+			}
+			raft_peer *leader = nullptr;
+			{
+				utils::lock_guard lock(mtx_);
+				for (auto &itr : pees_)
+					if (itr->myself_.raft_id_ == leader_id_)
+						leader = itr.get();
+			}
+			if (!leader)
+			{
+				callback(false, 0);
+				return;
+			}
+			read_index_request request;
+			request.term_ = current_term_;
+			request.follower_id_ = myself_.raft_id_;
+			request.request_id_ = ++read_index_request_id_;
+			auto request_id = request.request_id_;
+			{
+				std::unique_lock<std::mutex> lock(read_mtx_);
+				auto timer_id = timer_.set_timer(append_log_timeout_, [this, request_id] {
+					if (auto callback = take_pending_read_index(request_id))
+						callback(false, 0);
+				});
+				pending_read_indexes_.emplace(request_id, 
+					pending_read_index{ timer_id, std::move(callback) });
+			}
+			//the reply comes through read_index_reply, this only says 
+			//whether the leader took the request.
+			leader->send_read_index_request(request,
+				[this, request_id](bool ok, const read_index_response &response)
+			{
+				if (ok && current_term_ < response.term_)
+					handle_new_term(response.term_);
+				if (ok && response.success_)
+					return;
+				if (auto callback = take_pending_read_index(request_id))
+					callback(false, 0);
+			});
+		}
+		//bounded staleness, no network trip: true when the applied state
+		//is at most max_entries behind the newest leader commit heard and
+		//shows the leader as of at most max_ms ago. a negative bound is
+		//not checked. the leader is current as of the last majority ack,
+		//or now while it holds a lease, a deposed leader gets no acks.
+		bool check_staleness(int64_t max_entries, int64_t max_ms)
+		{
+			int64_t applied = last_applied_index_;
+			if (state_ == e_leader)
+			{
+				//the commit index of a new leader may lag the old one's.
+				if (!leader_term_committed_)
+					return false;
+				if (max_entries >= 0 && committed_index_ - applied > max_entries)
+					return false;
+				auto acked = raft_config_mgr_.get_majority() > 1 ? 
+					quorum_ack_time_.load() : steady_now();
+				if (max_ms >= 0 && !lease_valid() && steady_now() - acked > max_ms)
+					return false;
+				return true;
+			}
+			if (max_entries >= 0 && leader_commit_seen_ - applied > max_entries)
+				return false;
+			if (max_ms >= 0 && steady_now() - applied_fresh_time_ > max_ms)
+				return false;
+			return true;
+		}
+		//true while the leader holds a lease: a majority acked its
+		//AppendEntries within election timeout - clock drift.
+		bool lease_valid()
+		{
+			return lease_read_ && state_ == e_leader && leader_term_committed_ &&
+				steady_now() < lease_expire_;
+		}
+		//followers that hear from a leader refuse votes for an election
+		//timeout, which is what keeps a lease safe. clock_drift_ms bounds
+		//how much faster the leader's clock may run than a follower's.
+		void set_lease_read(bool enable, int64_t clock_drift_ms)
+		{
+			lease_clock_drift_ms_ = clock_drift_ms;
+			lease_read_ = enable;
+		}
+		//coalesce concurrent replicate calls into one log write, 
+		//one timer and one peer wakeup. max_bytes == 0 disables it.
+		void set_propose_batch(std::size_t max_bytes, int64_t max_wait_us)
+		{
+			std::lock_guard<std::mutex> lock(propose_mtx_);
+			propose_batch_max_bytes_ = max_bytes;
+			propose_batch_max_wait_us_ = max_wait_us;
 		}
 		void regist_commit_entry_callback(const commit_entry_callback &callback)
 		{
 			commit_entry_callback_ = callback;
 		}
+		//takes a run of committed entries at once, used instead of
+		//commit_entry_callback when it is set.
+		void regist_commit_entries_callback(const commit_entries_callback &callback)
+		{
+			commit_entries_callback_ = callback;
+		}
+		//the index the state machine has durably applied. init applies the
+		//committed entries after it again, for state machines that do not
+		//keep their own write-ahead log.
+		void regist_get_applied_index_handle(const get_applied_index_handle &handle)
+		{
+			get_applied_index_handle_ = handle;
+		}
 		void regist_build_snapshot_callback(const  build_snapshot_callback& callback)
 		{
 			build_snapshot_callback_ = callback;
 		}
+		//called on the commit thread with the applied index, take the
+		//state machine view the build callback will serialize there.
+		void regist_prepare_snapshot_callback(const prepare_snapshot_callback &callback)
+		{
+			prepare_snapshot_callback_ = callback;
+		}
 		void regist_install_snapshot_handle(const install_snapshot_callback &callback)
 		{
 			install_snapshot_callback_ = callback;
@@ -51,15 +194,30 @@ namespace xraft
 			init_config(config);
 			init_raft_log();
 			load_metadata();
+			replay_committed_entries();
+			apply_index_ = committed_index_;
 			init_rpc();
 			init_snapshot_builder();
  			init_pees();
 			init_timer();
  			set_election_timer();
+			election_ticker();
+			hard_state_flush_ticker();
 		}
 	private:
+		struct proposal
+		{
+			proposal(std::string &&data, append_log_callback &&callback)
+				:data_(std::move(data)),
+				callback_(std::move(callback))
+			{
+			}
+			std::string data_;
+			append_log_callback callback_;
+		};
 		void stop()
 		{
+			hard_state_.flush();
 			rpc_server_->stop();
 		}
 		void init_raft_log()
@@ -69,10 +227,16 @@ namespace xraft
 				std::cout << "raft log init failed" << std::endl;
 				throw std::runtime_error("raft log init failed");
 			}
+			log_.set_group_commit(group_commit_max_bytes_, group_commit_max_wait_us_);
+			log_.set_cache_max_bytes(log_cache_max_bytes_);
+			log_.set_persisted_callback([this](int64_t index) {
+				local_persisted_callback(index);
+			});
+			log_.set_persist_failed_callback([this](int64_t index) {
+				local_persist_failed_callback(index);
+			});
 			log_.set_make_snapshot_trigger([this] {
-				commiter_.push([this] {
-						snapshot_builder_.make_snapshot();
-					});
+				schedule_snapshot();
 			});
 		}
 		void load_metadata()
@@ -99,9 +263,40 @@ namespace xraft
 				last_snapshot_index_ = last_snapshot_index;
 			if (metadata_.get("last_applied_index", last_applied_index))
 				last_applied_index_ = last_applied_index;
+
+			if (!hard_state_.init(metadata_base_path_))
+			{
+				std::cout << "init hard state failed" << std::endl;
+				std::exit(0);
+			}
+			if (hard_state_.is_loaded())
+			{
+				current_term_ = hard_state_.get_term();
+				voted_for_ = hard_state_.get_vote();
+				committed_index_ = hard_state_.get_committed();
+				last_applied_index_ = hard_state_.get_applied();
+				return;
+			}
+			//first start after the per-field metadata, move it over.
+			hard_state_.set_committed(committed_index_);
+			hard_state_.set_applied(last_applied_index_);
+			if (!hard_state_.set_term_vote(current_term_, voted_for_))
+			{
+				std::cout << "write hard state failed" << std::endl;
+				std::exit(0);
+			}
+		}
+		void hard_state_flush_ticker()
+		{
+			timer_.set_timer(hard_state_flush_interval_ms_, [this] {
+				if (!hard_state_.flush())
+					std::cout << "flush hard state failed" << std::endl;
+				hard_state_flush_ticker();
+			});
 		}
 		void init_timer()
 		{
+			timer_.set_tick(timer_tick_ms_);
 			timer_.start();
 		}
 		void init_config(raft_config config)
@@ -114,10 +309,27 @@ namespace xraft
 			snapshot_base_path_ = config.snapshot_base_path_;
 			append_log_timeout_ = config.append_log_timeout_;
 			election_timeout_ = config.election_timeout_;
+			group_commit_max_bytes_ = config.group_commit_max_bytes_;
+			group_commit_max_wait_us_ = config.group_commit_max_wait_us_;
+			log_cache_max_bytes_ = config.log_cache_max_bytes_;
+			async_log_persist_ = config.async_log_persist_;
+			append_entries_pipeline_window_ = config.append_entries_pipeline_window_;
+			propose_batch_max_bytes_ = config.propose_batch_max_bytes_;
+			propose_batch_max_wait_us_ = config.propose_batch_max_wait_us_;
+			timer_tick_ms_ = config.timer_tick_ms_;
+			hard_state_flush_interval_ms_ = config.hard_state_flush_interval_ms_;
+			snapshot_chunk_bytes_ = config.snapshot_chunk_bytes_;
+			snapshot_window_ = config.snapshot_window_;
+			snapshot_channel_port_offset_ = config.snapshot_channel_port_offset_;
+			snapshot_min_interval_ms_ = config.snapshot_min_interval_ms_;
+			snapshot_codec_ = config.snapshot_codec_;
+			snapshot_block_bytes_ = config.snapshot_block_bytes_;
+			set_lease_read(config.lease_read_, config.lease_clock_drift_ms_);
 		}
 		void init_snapshot_builder()
 		{
 			snapshot_builder_.set_snapshot_base_path(snapshot_base_path_);
+			snapshot_builder_.set_codec(snapshot_codec_, snapshot_block_bytes_);
 			
 			snapshot_builder_.regist_build_snapshot_callback(
 				std::bind(&raft::make_snapshot_callback, this,
@@ -127,6 +339,13 @@ namespace xraft
 				std::bind(&raft::make_snapshot_done_callback, this, 
 					std::placeholders::_1));
 
+			//the log keeps its prefix, try again on a later log file.
+			snapshot_builder_.regist_build_snapshot_failed_callback([this](int64_t) {
+				log_.set_make_snapshot_trigger([this] {
+					schedule_snapshot();
+				});
+			});
+
 			snapshot_builder_.regist_get_applied_index_handle([this] {
 				return last_applied_index_.load(); 
 			});
@@ -141,7 +360,18 @@ namespace xraft
 			rpc_server_->register_handler("append_entries_request", timax::bind(&raft::handle_append_entries_request, this));
 			rpc_server_->register_handler("vote_request", timax::bind(&raft::handle_vote_request, this));
 			rpc_server_->register_handler("install_snapshot", timax::bind(&raft::handle_install_snapshot, this));
+			rpc_server_->register_handler("read_index_request", timax::bind(&raft::handle_read_index_request, this));
+			rpc_server_->register_handler("read_index_reply", timax::bind(&raft::handle_read_index_reply, this));
 			rpc_server_->start();
+			if (snapshot_channel_port_offset_)
+			{
+				snapshot_channel_.set_timeout(election_timeout_);
+				snapshot_channel_.regist_stream_handle(
+					[this](const snapshot_stream_head &head, snapshot_channel_server::socket_t &socket) {
+					return handle_snapshot_stream(head, socket);
+				});
+				snapshot_channel_.start((uint16_t)(myself_.port_ + snapshot_channel_port_offset_));
+			}
 		}
 		void init_pees()
 		{
@@ -152,7 +382,16 @@ namespace xraft
 					continue;
 				pees_.emplace_back(new raft_peer(itr));
 				raft_peer &peer = *(pees_.back());
-				peer.append_entries_success_callback_ = timax::bind(&raft::append_entries_callback, this);
+				auto peer_pos = pees_.size() - 1;
+				peer.append_entries_success_callback_ = [this, peer_pos](int64_t match_index) {
+					append_entries_callback(peer_pos, match_index);
+				};
+				peer.read_round_callback_ = [this, peer_pos](uint64_t round) {
+					read_round_callback(peer_pos, round);
+				};
+				peer.lease_ack_callback_ = [this, peer_pos](int64_t send_time) {
+					lease_ack_callback(peer_pos, send_time);
+				};
 				peer.build_append_entries_request_ = timax::bind(&raft::build_append_entries_request, this);
 				peer.build_vote_request_ = timax::bind(&raft::build_vote_request, this);
 				peer.vote_response_callback_ = timax::bind(&raft::handle_vote_response, this);
@@ -161,9 +400,16 @@ namespace xraft
 				peer.get_last_log_index_ = timax::bind(&raft::get_last_log_entry_index, this);
 				peer.get_snapshot_path_ = timax::bind(&raft::get_snapshot_filepath, this);
 				peer.raft_id_ = myself_.raft_id_;
+				peer.pipeline_window_ = append_entries_pipeline_window_;
+				peer.snapshot_chunk_bytes_ = snapshot_chunk_bytes_;
+				peer.snapshot_window_ = std::max<std::size_t>(snapshot_window_, 1);
+				peer.snapshot_channel_port_offset_ = snapshot_channel_port_offset_;
 				peer.start();
 				peer.send_cmd(raft_peer::cmd_t::e_connect);
 			}
+			peer_match_indexes_.assign(pees_.size(), 0);
+			peer_read_rounds_.assign(pees_.size(), 0);
+			peer_lease_acks_.assign(pees_.size(), 0);
 		}
 		void peer_connect_callback(raft_peer &peer, bool result)
 		{
@@ -181,7 +427,11 @@ namespace xraft
 		void do_relicate(std::string &&data, append_log_callback&&callback)
 		{
 			int64_t index;
-			if (!log_.write(build_log_entry(std::move(data)), index))
+			auto entry = build_log_entry(std::move(data));
+			auto result = async_log_persist_ ?
+				log_.append(std::move(entry), index) :
+				log_.write(std::move(entry), index);
+			if (!result)
 			{
 				append_log_callback handle;
 				commiter_.push([handle = std::move(callback)] {
@@ -192,6 +442,47 @@ namespace xraft
 			insert_callback(index, set_timeout(index), std::move(callback));
 			notify_peers();
 		}
+		void flush_proposals()
+		{
+			std::unique_lock<std::mutex> lock(propose_mtx_);
+			propose_cv_.wait_for(lock, microseconds(propose_batch_max_wait_us_), [this] {
+				return proposals_bytes_ >= propose_batch_max_bytes_;
+			});
+			std::vector<proposal> batch;
+			batch.swap(proposals_);
+			proposals_bytes_ = 0;
+			lock.unlock();
+			if (batch.empty())
+				return;
+			do_relicate(std::move(batch));
+		}
+		void do_relicate(std::vector<proposal> &&batch)
+		{
+			std::vector<log_entry> entries;
+			entries.reserve(batch.size());
+			for (auto &itr : batch)
+				entries.emplace_back(build_log_entry(std::move(itr.data_)));
+			int64_t last_index;
+			auto result = async_log_persist_ ?
+				log_.append(std::move(entries), last_index) :
+				log_.write(std::move(entries), last_index);
+			if (!result)
+			{
+				commiter_.push([batch = std::move(batch)] {
+					for (auto &itr : batch)
+						itr.callback_(false, 0);
+				});
+				return;
+			}
+			auto first_index = last_index - (int64_t)batch.size() + 1;
+			auto timer_id = set_timeout(first_index, last_index);
+			std::unique_lock<std::mutex> lock(mtx_);
+			auto index = first_index;
+			for (auto &itr : batch)
+				insert_callback_no_lock(index++, timer_id, last_index, std::move(itr.callback_));
+			lock.unlock();
+			notify_peers();
+		}
 		append_entries_response 
 			handle_append_entries_request(append_entries_request & request)
 		{
@@ -217,7 +508,8 @@ namespace xraft
 				leader_id_ = request.leader_id_;
 				//todo log Warm
 			}
-			utils::guard guard([this] { set_election_timer(); });
+			utils::guard guard([this] { touch_leader_heard(); });
+			note_leader_commit(request.leader_commit_);
 			
 			if (last_snapshot_index_ > get_last_log_entry_index())
 			{
@@ -271,20 +563,13 @@ namespace xraft
 				log_.write(std::move(itr), index);
 			}
 			response.last_log_index_ = get_last_log_entry_index();
-			if (committed_index_ < request.leader_commit_)
+			//only the entries this request matched are known to be the leader's.
+			auto last_new_index = request.prev_log_index_ + (int64_t)request.entries_.size();
+			auto commit_index = std::min(request.leader_commit_, last_new_index);
+			if (committed_index_ < commit_index)
 			{
-				auto leader_commit_ = request.leader_commit_;
-				commiter_.push([leader_commit_,this] {
-					auto entries = log_.get_log_entries(committed_index_ + 1, 
-						leader_commit_ - committed_index_);
-					for (auto &itr : entries)
-					{
-						assert(itr.index_ == committed_index_ + 1);
-						commit_entry_callback_(std::move(itr.log_data_),itr.index_);
-						set_committed_index(committed_index_+1);
-						set_last_applied(committed_index_);
-					}
-				});
+				set_committed_index(commit_index);
+				schedule_apply(commit_index);
 			}
 			return response;
 		}
@@ -310,8 +595,17 @@ namespace xraft
 					<< get_last_log_entry_index() << std::endl;
 				is_ok = true;
 			}
-				
-			//todo hold votes check
+
+			//a follower that heard from the leader within an election
+			//timeout keeps it, the leader's lease relies on that.
+			if (lease_read_ && state_ == state::e_follower &&
+				steady_now() - last_leader_heard_ < election_timeout_)
+			{
+				response.term_ = current_term_;
+				response.vote_granted_ = false;
+				response.log_ok_ = is_ok;
+				return response;
+			}
 
 			if (request.term_ > current_term_)
 			{
@@ -332,9 +626,58 @@ namespace xraft
 			response.log_ok_ = is_ok;
 			return response;
 		}
+		//returns at once, the read index goes back to the follower through
+		//read_index_reply when the heartbeat round is done.
+		read_index_response handle_read_index_request(const read_index_request &request)
+		{
+			read_index_response response;
+			response.term_ = current_term_;
+			response.request_id_ = request.request_id_;
+			if (request.term_ > current_term_ || state_ != e_leader)
+				return response;
+			raft_peer *follower = nullptr;
+			{
+				utils::lock_guard lock(mtx_);
+				for (auto &itr : pees_)
+					if (itr->myself_.raft_id_ == request.follower_id_)
+						follower = itr.get();
+			}
+			if (!follower)
+				return response;
+			response.success_ = true;
+			confirm_read_index([this, follower, reply = response](bool ok, int64_t index) mutable {
+				reply.term_ = current_term_;
+				reply.success_ = ok;
+				reply.index_ = index;
+				follower->send_read_index_reply(reply);
+			}, false);
+			return response;
+		}
+		bool handle_read_index_reply(const read_index_response &reply)
+		{
+			auto callback = take_pending_read_index(reply.request_id_);
+			if (!callback)
+				return false;
+			if (current_term_ < reply.term_)
+				handle_new_term(reply.term_);
+			callback(reply.success_, reply.index_);
+			return true;
+		}
+		read_index_callback take_pending_read_index(uint64_t request_id)
+		{
+			std::unique_lock<std::mutex> lock(read_mtx_);
+			auto itr = pending_read_indexes_.find(request_id);
+			if (itr == pending_read_indexes_.end())
+				return nullptr;
+			timer_.cancel(itr->second.timer_id_);
+			auto callback = std::move(itr->second.callback_);
+			pending_read_indexes_.erase(itr);
+			return callback;
+		}
 		install_snapshot_response
 			handle_install_snapshot (install_snapshot_request &request)
 		{
+			std::lock_guard<std::mutex> locker(mtx_);
 			install_snapshot_response response;
 			response.term_ = current_term_;
 			if (request.term_ < current_term_)
@@ -349,7 +692,7 @@ namespace xraft
 				response.term_ = request.term_;
 			}
 			step_down(request.term_);
-			set_election_timer();
+			touch_leader_heard();
 			if (leader_id_.empty())
 			{
 				leader_id_ = request.leader_id_;
@@ -359,24 +702,69 @@ namespace xraft
 			{
 				//logo error;
 			}
+			std::lock_guard<std::mutex> snapshot_locker(snapshot_mtx_);
 
+			if (snapshot_writer_ && 
+				snapshot_writer_index_ != request.last_snapshot_index_)
+			{
+				snapshot_writer_.discard();
+				snapshot_chunks_.clear();
+			}
 			if (!snapshot_writer_)
+			{
 				open_snapshot_writer(request.last_snapshot_index_);
-			response.bytes_stored_ = snapshot_writer_.get_bytes_writted();
-			if (request.offset_ != snapshot_writer_.get_bytes_writted())
+				snapshot_writer_index_ = request.last_snapshot_index_;
+				snapshot_chunks_.clear();
+			}
+			int64_t bytes_writted = snapshot_writer_.get_bytes_writted();
+			response.bytes_stored_ = bytes_writted;
+			//chunks of the window may overtake each other, 
+			//keep the early ones until the gap is filled.
+			if (request.offset_ > bytes_writted)
+			{
+				if (snapshot_chunks_.size() >= max_snapshot_chunks_)
+					return response;
+				response.bytes_stored_ = request.offset_ + (int64_t)request.data_.size();
+				auto offset = request.offset_;
+				snapshot_chunks_.emplace(offset, std::move(request));
+				return response;
+			}
+			if (request.offset_ != bytes_writted)
 			{
 				//todo LOG WRAM
-				response.bytes_stored_ = snapshot_writer_.get_bytes_writted();
 				return response;
 			}
+			auto done = request.done_;
 			if (!snapshot_writer_.write(request.data_))
 			{
 				//todo LOG ERROR;
 				return response;
 			}
+			while (!done && snapshot_chunks_.size())
+			{
+				auto itr = snapshot_chunks_.begin();
+				bytes_writted = snapshot_writer_.get_bytes_writted();
+				if (itr->first > bytes_writted)
+					break;
+				if (itr->first == bytes_writted)
+				{
+					if (!snapshot_writer_.write(itr->second.data_))
+						return response;
+					done = itr->second.done_;
+				}
+				snapshot_chunks_.erase(itr);
+			}
 			response.bytes_stored_ = snapshot_writer_.get_bytes_writted();
-			if (request.done_)
+			if (done)
 			{
+				snapshot_chunks_.clear();
+				if (!snapshot_writer_.sync())
+				{
+					//todo LOG ERROR;
+					snapshot_writer_.discard();
+					response.bytes_stored_ = 0;
+					return response;
+				}
 				if (request.last_snapshot_index_ < last_snapshot_index_)
 				{
 					//todo Warm
@@ -387,6 +775,48 @@ namespace xraft
 			}
 			return response;
 		}
+		//the bytes go straight from the socket to the snapshot file,
+		//the final InstallSnapshot chunk still syncs and loads it.
+		int64_t handle_snapshot_stream(const snapshot_stream_head &head, 
+			snapshot_channel_server::socket_t &socket)
+		{
+			if (head.term_ < current_term_)
+			{
+				snapshot_channel_server::reply(socket, -1);
+				return -1;
+			}
+			int64_t bytes_stored = -1;
+			{
+				std::lock_guard<std::mutex> lock(snapshot_mtx_);
+				if (snapshot_writer_ && snapshot_writer_index_ == head.last_snapshot_index_)
+					bytes_stored = snapshot_writer_.get_bytes_writted();
+			}
+			snapshot_channel_server::reply(socket, bytes_stored);
+			if (bytes_stored != head.offset_)
+				return -1;
+			//snapshot_mtx_ is only held to write a buffer, the socket is
+			//read without it so a slow sender never stalls mtx_ holders.
+			std::string buffer(256 * 1024, '\0');
+			int64_t remain = head.length_;
+			while (remain > 0)
+			{
+				auto bytes = snapshot_channel_server::read_some(socket, &buffer[0],
+					(std::size_t)std::min<int64_t>(remain, buffer.size()),
+					snapshot_channel_.get_timeout());
+				if (head.term_ == current_term_)
+					touch_leader_heard();
+				std::lock_guard<std::mutex> lock(snapshot_mtx_);
+				//the writer was discarded or moved on to another snapshot.
+				if (!snapshot_writer_ || snapshot_writer_index_ != head.last_snapshot_index_ ||
+					snapshot_writer_.get_bytes_writted() != bytes_stored)
+					return -1;
+				if (!snapshot_writer_.write(buffer.data(), bytes))
+					return -1;
+				bytes_stored += (int64_t)bytes;
+				remain -= (int64_t)bytes;
+			}
+			return bytes_stored;
+		}
 		void load_snapshot()
 		{
 			snapshot_writer_.close();
@@ -406,6 +836,11 @@ namespace xraft
 			log_.truncate_suffix(1);
 			if (head.last_included_index_ > committed_index_)
 				set_committed_index(head.last_included_index_);
+			if (head.last_included_index_ > apply_index_)
+			{
+				apply_index_ = head.last_included_index_;
+				commiter_.push([this, index = apply_index_] { set_last_applied(index); });
+			}
 		}
 		void open_snapshot_writer(int64_t index)
 		{
@@ -431,6 +866,7 @@ namespace xraft
 				leader_id_.clear();
 				set_voted_for("");
 				update_Log_metadata();
+				std::lock_guard<std::mutex> lock(snapshot_mtx_);
 				if(snapshot_writer_)
 					snapshot_writer_.discard();
 			}
@@ -442,28 +878,61 @@ namespace xraft
 			if (state_ == state::e_leader)
 			{
 				sleep_peer_threads();
+				lease_expire_ = 0;
+				quorum_ack_time_ = 0;
+				fail_read_requests();
 			}
 			state_ = state::e_follower;
 			set_election_timer();
 		}
+		//arm the election deadline with a new random timeout.
 		void set_election_timer()
 		{
-			cancel_election_timer();
-			std::random_device rd;
-			std::mt19937 gen(rd());
 			std::uniform_int_distribution<> dis(1, (int)election_timeout_);
-			set_voted_for("");
-			election_timer_id_ = timer_.set_timer(election_timeout_+ dis(gen),[this] {
-				std::cout << "------election timer callback------" << std::endl;
-				std::lock_guard<std::mutex> lock(mtx_);
-				set_term(current_term_ + 1);
-				state_ = state::e_candidate;
-				set_voted_for(myself_.raft_id_);
-				for (auto &itr : pees_)
-					itr->send_cmd(raft_peer::cmd_t::e_election);
-				set_election_timer();
+			election_deadline_ = election_timeout_ + dis(election_rand_);
+			touch_leader_contact();
+			election_timer_enabled_ = true;
+		}
+		//heartbeats only refresh the contact time, the ticker checks it.
+		void touch_leader_contact()
+		{
+			last_leader_contact_ = duration_cast<milliseconds>(
+				steady_clock::now().time_since_epoch()).count();
+		}
+		//only AppendEntries and snapshots of the current leader get here,
+		//re-arming the election timer does not count for vote refusal.
+		void touch_leader_heard()
+		{
+			touch_leader_contact();
+			last_leader_heard_ = last_leader_contact_.load();
+		}
+		void election_ticker()
+		{
+			auto tick = std::max<int64_t>(election_timeout_ / 10, 1);
+			timer_.set_timer(tick, [this] {
+				check_election_deadline();
+				election_ticker();
 			});
 		}
+		void check_election_deadline()
+		{
+			if (!election_timer_enabled_)
+				return;
+			auto now = duration_cast<milliseconds>(
+				steady_clock::now().time_since_epoch()).count();
+			if (now - last_leader_contact_ < election_deadline_)
+				return;
+			std::cout << "------election timer callback------" << std::endl;
+			std::lock_guard<std::mutex> lock(mtx_);
+			if (!election_timer_enabled_)
+				return;
+			set_term(current_term_ + 1);
+			state_ = state::e_candidate;
+			set_voted_for(myself_.raft_id_);
+			for (auto &itr : pees_)
+				itr->send_cmd(raft_peer::cmd_t::e_election);
+			set_election_timer();
+		}
 		void sleep_peer_threads()
 		{
 			TRACE;
@@ -475,19 +944,46 @@ namespace xraft
 		{
 			metadata_.set("leader_id", leader_id_);
 		}
+		//the leader's own durable write is one of the acks of the quorum.
+		//called on the log's notifier thread, never on its persister.
+		void local_persisted_callback(int64_t index)
+		{
+			utils::lock_guard lock(mtx_);
+			if (index <= local_persisted_index_)
+				return;
+			local_persisted_index_ = index;
+			advance_committed_index();
+		}
+		//the entries from index on are gone from our log, followers may
+		//have them, so leadership is handed to a node that has them.
+		void local_persist_failed_callback(int64_t index)
+		{
+			utils::lock_guard lock(mtx_);
+			auto itr = append_log_callbacks_.lower_bound(index);
+			while (itr != append_log_callbacks_.end())
+			{
+				if (itr->first == itr->second.timer_last_index_)
+					timer_.cancel(itr->second.timer_id_);
+				commiter_.push([func = std::move(itr->second.callback_)]{ func(false, 0); });
+				itr = append_log_callbacks_.erase(itr);
+			}
+			if (state_ == e_leader)
+				step_down(current_term_);
+		}
 		struct append_log_callback_info
 		{
-			append_log_callback_info(int waits, int64_t index, int64_t timer_id,
-				append_log_callback && callback)
-					:waits_(waits),
-					timer_id_(timer_id),
+			append_log_callback_info(int64_t index, int64_t timer_id,
+				int64_t timer_last_index, append_log_callback && callback)
+					:timer_id_(timer_id),
+					timer_last_index_(timer_last_index),
 					callback_(callback),
 					index_(index)
 			{
 			}
 			int64_t index_;
-			int waits_;
 			int64_t timer_id_;
+			//a batch shares one timer, it ends with this index.
+			int64_t timer_last_index_;
 			append_log_callback callback_;
 		};
 		void notify_peers()
@@ -498,20 +994,32 @@ namespace xraft
 		void insert_callback(int64_t index, int64_t timer_id, append_log_callback &&callback)
 		{
 			utils::lock_guard lock(mtx_);
+			insert_callback_no_lock(index, timer_id, index, std::move(callback));
+		}
+		void insert_callback_no_lock(int64_t index, int64_t timer_id, 
+			int64_t timer_last_index, append_log_callback &&callback)
+		{
 			append_log_callbacks_.emplace(
 				std::piecewise_construct, std::forward_as_tuple(index),
-				std::forward_as_tuple(raft_config_mgr_.get_majority() - 1, index,  timer_id, std::move(callback)));
+				std::forward_as_tuple(index, timer_id, 
+					timer_last_index, std::move(callback)));
+			//the quorum may have reached it before the callback was inserted.
+			advance_committed_index();
 		}
 		int64_t set_timeout(int64_t index)
 		{
-			return timer_.set_timer(append_log_timeout_, [this, index] {
+			return set_timeout(index, index);
+		}
+		int64_t set_timeout(int64_t first_index, int64_t last_index)
+		{
+			return timer_.set_timer(append_log_timeout_, [this, first_index, last_index] {
 				utils::lock_guard lock(mtx_);
-				auto itr = append_log_callbacks_.find(index);
-				if (itr == append_log_callbacks_.end())
-					return;
-				append_log_callback func;
-				commiter_.push([func = std::move(itr->second.callback_)]{ func(false, 0); });
-				append_log_callbacks_.erase(itr);
+				auto itr = append_log_callbacks_.lower_bound(first_index);
+				while (itr != append_log_callbacks_.end() && itr->first <= last_index)
+				{
+					commiter_.push([func = std::move(itr->second.callback_)]{ func(false, 0); });
+					itr = append_log_callbacks_.erase(itr);
+				}
 			});
 		}
 		log_entry build_log_entry(std::string &&log, 
@@ -583,12 +1091,44 @@ namespace xraft
 			TRACE;
 			state_ = e_leader;
 			cancel_election_timer();
+			leader_term_committed_ = false;
+			{
+				std::unique_lock<std::mutex> lock(read_mtx_);
+				peer_lease_acks_.assign(pees_.size(), 0);
+				lease_expire_ = 0;
+				quorum_ack_time_ = 0;
+			}
+			{
+				utils::lock_guard lock(mtx_);
+				peer_match_indexes_.assign(pees_.size(), 0);
+				//entries written as a follower are on disk already.
+				local_persisted_index_ = std::max(local_persisted_index_, 
+					log_.get_persisted_index());
+			}
+			append_noop_entry();
 			for (auto &itr : pees_)
 				itr->send_cmd(raft_peer::cmd_t::e_append_entries);
 		}
+		//committing an entry of the new term commits the earlier ones too,
+		//and read_index can not start before the leader knows its commit index.
+		void append_noop_entry()
+		{
+			int64_t index;
+			auto entry = build_log_entry("", log_entry::type::e_noop);
+			auto result = async_log_persist_ ?
+				log_.append(std::move(entry), index) :
+				log_.write(std::move(entry), index);
+			if (!result)
+			{
+				std::cout << "append no-op entry failed" << std::endl;
+				return;
+			}
+			utils::lock_guard lock(mtx_);
+			advance_committed_index();
+		}
 		void cancel_election_timer()
 		{
-			timer_.cancel(election_timer_id_);
+			election_timer_enabled_ = false;
 		}
 		vote_request build_vote_request()
 		{
@@ -626,39 +1166,146 @@ namespace xraft
 			std::sort(files.begin(), files.end(), snapshort_comper());
 			return files[0];
 		}
-		void append_entries_callback(const std::vector<int64_t> &indexs)
+		void append_entries_callback(std::size_t peer, int64_t match_index)
 		{
 			utils::lock_guard lock(mtx_);
-			for (auto &itr : indexs)
+			if (match_index <= peer_match_indexes_[peer])
+				return;
+			peer_match_indexes_[peer] = match_index;
+			advance_committed_index();
+		}
+		//the highest index stored on a majority, counting the leader's 
+		//own durable log.
+		int64_t get_quorum_match_index()
+		{
+			std::vector<int64_t> match_indexes(peer_match_indexes_);
+			match_indexes.push_back(async_log_persist_ ? 
+				local_persisted_index_ : log_.get_last_index());
+			auto majority = (std::size_t)raft_config_mgr_.get_majority();
+			if (majority > match_indexes.size())
+				return 0;
+			auto nth = match_indexes.begin() + (majority - 1);
+			std::nth_element(match_indexes.begin(), nth, 
+				match_indexes.end(), std::greater<int64_t>());
+			return *nth;
+		}
+		//complete every callback up to the quorum match index in one sweep.
+		void advance_committed_index()
+		{
+			if (state_ != e_leader)
+				return;
+			auto index = get_quorum_match_index();
+			if (index > committed_index_)
 			{
-				auto item = append_log_callbacks_.find(itr);
-				if (item == append_log_callbacks_.end())
-					continue;
-				item->second.waits_--;
-				if (item->second.waits_ == 0)
+				//only entries of the current term are committed by counting.
+				if (get_log_entry(index).term_ != current_term_)
+					return;
+				set_committed_index(index);
+				leader_term_committed_ = true;
+				schedule_apply(index);
+			}
+			auto end = append_log_callbacks_.upper_bound(committed_index_);
+			if (end == append_log_callbacks_.begin())
+				return;
+			std::vector<std::pair<int64_t, append_log_callback>> callbacks;
+			for (auto itr = append_log_callbacks_.begin(); itr != end; ++itr)
+			{
+				if (itr->first == itr->second.timer_last_index_)
+					timer_.cancel(itr->second.timer_id_);
+				callbacks.emplace_back(itr->first, std::move(itr->second.callback_));
+			}
+			append_log_callbacks_.erase(append_log_callbacks_.begin(), end);
+			//queued after the apply, the callbacks only report the result.
+			commiter_.push([callbacks = std::move(callbacks)]
+			{
+				for (auto &itr : callbacks)
+					itr.second(true, itr.first);
+			});
+		}
+		//every committed index is applied from the log, with or without a 
+		//callback, on the commit thread in log order. callers hold mtx_.
+		void schedule_apply(int64_t index)
+		{
+			if (index <= apply_index_)
+				return;
+			auto first_index = apply_index_ + 1;
+			apply_index_ = index;
+			commiter_.push([this, first_index, index] {
+				apply_entries(log_.get_log_entries(first_index, index - first_index + 1));
+				set_last_applied(index);
+			});
+		}
+		//the trigger is re-armed only when a build is done, so one runs at
+		//a time, and two builds start at least snapshot_min_interval_ms_ apart.
+		void schedule_snapshot()
+		{
+			auto now = duration_cast<milliseconds>(
+				steady_clock::now().time_since_epoch()).count();
+			auto wait = last_snapshot_build_ + snapshot_min_interval_ms_ - now;
+			if (wait > 0)
+			{
+				timer_.set_timer(wait, [this] { start_snapshot(); });
+				return;
+			}
+			start_snapshot();
+		}
+		//the view is taken on the commit thread, between two applies, then
+		//the snapshot worker serializes it while the commit thread goes on.
+		void start_snapshot()
+		{
+			commiter_.push([this] {
+				auto index = last_applied_index_.load();
+				if (prepare_snapshot_callback_)
+					prepare_snapshot_callback_(index);
+				snapshot_worker_.push([this, index] {
+					last_snapshot_build_ = duration_cast<milliseconds>(
+						steady_clock::now().time_since_epoch()).count();
+					snapshot_builder_.make_snapshot(index);
+				});
+			});
+		}
+		void apply_entries(std::list<log_entry> &&entries)
+		{
+			if (commit_entries_callback_)
+			{
+				commit_entries_callback_(std::move(entries));
+				return;
+			}
+			if (!commit_entry_callback_)
+				return;
+			for (auto &itr : entries)
+				if (itr.type_ == log_entry::type::e_append_log)
+					commit_entry_callback_(std::move(itr.log_data_), itr.index_);
+		}
+		//runs in init before the rpc server starts, so no AppendEntries
+		//commit can apply later entries ahead of the replayed ones.
+		void replay_committed_entries()
+		{
+			if (!get_applied_index_handle_)
+				return;
+			auto applied_index = get_applied_index_handle_();
+			//the committed index is stored lazily, the state machine may be ahead.
+			if (applied_index > committed_index_)
+				set_committed_index(applied_index);
+			if (applied_index < committed_index_)
+			{
+				if (applied_index + 1 < get_log_start_index())
 				{
-					timer_.cancel(item->second.timer_id_);
-					set_committed_index(item->first);
-					append_log_callback func;
-					int64_t index = committed_index_;
-					commiter_.push([func = std::move(item->second.callback_),this, index]
-					{ 
-						func(true, index); 
-						set_last_applied(index);
-					});
-					append_log_callbacks_.erase(item);
+					std::cout << "state machine applied index " << applied_index 
+						<< " is behind the log start " << get_log_start_index() << std::endl;
+					return;
 				}
+				apply_entries(log_.get_log_entries(applied_index + 1,
+					committed_index_ - applied_index));
 			}
+			set_last_applied(committed_index_);
 		}
 		bool make_snapshot_callback(const std::function<bool(const std::string &)> &writer, int64_t index)
 		{
-			cancel_election_timer();
 			return build_snapshot_callback_(writer, index);
 		}
 		void make_snapshot_done_callback(int64_t index)
 		{
-			if(!check_leader())
-				set_election_timer();
 			snapshot_reader reader;
 			auto filepath = get_snapshot_filepath();
 			if (!reader.open(filepath))
@@ -681,10 +1328,7 @@ namespace xraft
 			set_last_snapshot_term(head.last_included_term_);
 
 			log_.set_make_snapshot_trigger([this] {
-
-				commiter_.push([this] {
-					snapshot_builder_.make_snapshot();
-				});
+				schedule_snapshot();
 			});
 			log_.truncate_prefix(index);
 		}
@@ -712,39 +1356,209 @@ namespace xraft
 			if(!raft_id.empty())
 				TRACE;
 			voted_for_ = raft_id;
-			if (!metadata_.set("voted_for", voted_for_))
+			if (!hard_state_.set_term_vote(current_term_, voted_for_))
 			{
 				//todo log error;
-				throw std::runtime_error("metadata::set [voted_for] failed");
+				throw std::runtime_error("hard_state::set_term_vote [voted_for] failed");
 			}
 		}
 		void set_committed_index(int64_t index)
 		{
 			committed_index_ = index;
-			if (!metadata_.set("committed_index", committed_index_.load()))
-			{
-				//todo log error;
-				throw std::runtime_error("metadata::set [committed_index] failed");
-			}
+			hard_state_.set_committed(index);
 		}
 		void set_last_applied(int64_t index)
 		{
 			last_applied_index_ = index;
-			if (!metadata_.set("last_applied_index", index))
+			hard_state_.set_applied(index);
+			complete_read_waiters();
+			update_applied_fresh_time();
+		}
+		//the time is taken on receipt, so it is late by one network delay.
+		void note_leader_commit(int64_t commit)
+		{
+			auto now = steady_now();
+			std::lock_guard<std::mutex> lock(staleness_mtx_);
+			if (commit > leader_commit_seen_)
+				leader_commit_seen_ = commit;
+			if (commit <= last_applied_index_)
 			{
-				//todo log error;
-				throw std::runtime_error("metadata::set [committed_index] failed");
+				applied_fresh_time_ = now;
+				return;
+			}
+			//a later time at a lower commit makes the entries above it useless.
+			while (leader_commits_.size() && leader_commits_.back().first >= commit)
+				leader_commits_.pop_back();
+			leader_commits_.emplace_back(commit, now);
+		}
+		void update_applied_fresh_time()
+		{
+			std::lock_guard<std::mutex> lock(staleness_mtx_);
+			while (leader_commits_.size() && leader_commits_.front().first <= last_applied_index_)
+			{
+				applied_fresh_time_ = leader_commits_.front().second;
+				leader_commits_.pop_front();
+			}
+		}
+		//wait_applied: the callback waits until the index is applied here,
+		//follower reads wait on their own side.
+		void confirm_read_index(read_index_callback &&callback, bool wait_applied)
+		{
+			std::unique_lock<std::mutex> lock(read_mtx_);
+			//the commit index is only known to be current once an entry
+			//of this term has been committed.
+			if (state_ != e_leader || !leader_term_committed_)
+			{
+				lock.unlock();
+				callback(false, 0);
+				return;
 			}
+			if (lease_valid())
+			{
+				//under the lease no other leader can exist, the commit index is current.
+				int64_t index = committed_index_;
+				if (!wait_applied || last_applied_index_ >= index)
+				{
+					lock.unlock();
+					callback(true, index);
+					return;
+				}
+				read_waiters_.emplace(index, std::move(callback));
+				complete_read_waiters_no_lock();
+				return;
+			}
+			//a round already in flight may have been sent before this call.
+			read_requests_.push_back({ read_round_sent_ + 1, committed_index_,
+				wait_applied, std::move(callback) });
+			if (read_round_sent_ == read_round_acked_)
+				start_read_round();
+		}
+		void start_read_round()
+		{
+			++read_round_sent_;
+			for (auto &itr : pees_)
+				itr->request_read_round(read_round_sent_);
+			//a single node confirms its own round.
+			check_read_rounds();
+		}
+		void read_round_callback(std::size_t peer, uint64_t round)
+		{
+			std::unique_lock<std::mutex> lock(read_mtx_);
+			if (round <= peer_read_rounds_[peer])
+				return;
+			peer_read_rounds_[peer] = round;
+			check_read_rounds();
+		}
+		//the newest round a majority answered, counting the leader.
+		void check_read_rounds()
+		{
+			std::vector<uint64_t> rounds(peer_read_rounds_);
+			rounds.push_back(read_round_sent_);
+			auto majority = (std::size_t)raft_config_mgr_.get_majority();
+			if (majority > rounds.size())
+				return;
+			auto nth = rounds.begin() + (majority - 1);
+			std::nth_element(rounds.begin(), nth, rounds.end(), std::greater<uint64_t>());
+			if (*nth <= read_round_acked_)
+				return;
+			read_round_acked_ = *nth;
+			std::vector<std::pair<int64_t, read_index_callback>> confirmed;
+			while (read_requests_.size() && read_requests_.front().round_ <= read_round_acked_)
+			{
+				auto &request = read_requests_.front();
+				if (request.wait_applied_)
+					read_waiters_.emplace(request.index_, std::move(request.callback_));
+				else
+					confirmed.emplace_back(request.index_, std::move(request.callback_));
+				read_requests_.pop_front();
+			}
+			//the reads that came in during this round get the next one.
+			if (read_requests_.size())
+				start_read_round();
+			complete_read_waiters_no_lock();
+			if (confirmed.size())
+			{
+				commiter_.push([confirmed = std::move(confirmed)]{
+					for (auto &itr : confirmed)
+						itr.second(true, itr.first);
+				});
+			}
+		}
+		void lease_ack_callback(std::size_t peer, int64_t send_time)
+		{
+			if (state_ != e_leader)
+				return;
+			std::unique_lock<std::mutex> lock(read_mtx_);
+			if (send_time <= peer_lease_acks_[peer])
+				return;
+			peer_lease_acks_[peer] = send_time;
+			//the leader acks itself now, the majority-th newest ack starts the lease.
+			std::vector<int64_t> acks(peer_lease_acks_);
+			acks.push_back(steady_now());
+			auto majority = (std::size_t)raft_config_mgr_.get_majority();
+			if (majority > acks.size())
+				return;
+			auto nth = acks.begin() + (majority - 1);
+			std::nth_element(acks.begin(), nth, acks.end(), std::greater<int64_t>());
+			if (!*nth)
+				return;
+			if (*nth > quorum_ack_time_)
+				quorum_ack_time_ = *nth;
+			if (!lease_read_)
+				return;
+			auto expire = *nth + election_timeout_ - lease_clock_drift_ms_;
+			if (expire > lease_expire_)
+				lease_expire_ = expire;
+		}
+		static int64_t steady_now()
+		{
+			return duration_cast<milliseconds>(
+				steady_clock::now().time_since_epoch()).count();
+		}
+		void complete_read_waiters()
+		{
+			std::unique_lock<std::mutex> lock(read_mtx_);
+			complete_read_waiters_no_lock();
+		}
+		void complete_read_waiters_no_lock()
+		{
+			auto end = read_waiters_.upper_bound(last_applied_index_);
+			if (end == read_waiters_.begin())
+				return;
+			std::vector<std::pair<int64_t, read_index_callback>> callbacks;
+			for (auto itr = read_waiters_.begin(); itr != end; ++itr)
+				callbacks.emplace_back(itr->first, std::move(itr->second));
+			read_waiters_.erase(read_waiters_.begin(), end);
+			commiter_.push([callbacks = std::move(callbacks)]{
+				for (auto &itr : callbacks)
+					itr.second(true, itr.first);
+			});
+		}
+		//reads not confirmed yet can not be served by a former leader.
+		void fail_read_requests()
+		{
+			std::list<read_request> requests;
+			{
+				std::unique_lock<std::mutex> lock(read_mtx_);
+				requests.swap(read_requests_);
+				read_round_acked_ = read_round_sent_;
+			}
+			if (requests.empty())
+				return;
+			commiter_.push([requests = std::move(requests)]{
+				for (auto &itr : requests)
+					itr.callback_(false, 0);
+			});
 		}
 		void set_term(int64_t term)
 		{
 			TRACE;
 			std::cout << "term:" << term << std::endl;
 			current_term_ = term;
-			if (!metadata_.set("current_term", term))
+			if (!hard_state_.set_term_vote(term, voted_for_))
 			{
 				//todo log error;
-				throw std::runtime_error("metadata::set [current_term] failed");
+				throw std::runtime_error("hard_state::set_term_vote [current_term] failed");
 			}
 		}
 		void set_last_snapshot_index(int64_t index)
@@ -775,18 +1589,27 @@ namespace xraft
 		std::atomic_int64_t current_term_ = 0;
 		std::atomic_int64_t committed_index_ = 0;
 		std::atomic_int64_t last_applied_index_ = 0;
+		//the last index handed to the commit thread, under mtx_.
+		int64_t apply_index_ = 0;
 
 		std::string voted_for_;
 		std::string leader_id_;
 		int64_t election_timeout_ = 10000;
-		int64_t election_timer_id_ = 0;
+		std::atomic_bool election_timer_enabled_ = false;
+		std::atomic_int64_t election_deadline_ = 0;
+		std::atomic_int64_t last_leader_contact_ = 0;
+		std::atomic_int64_t last_leader_heard_ = 0;
+		std::mt19937 election_rand_{ std::random_device{}() };
 
 		commit_entry_callback commit_entry_callback_;
+		commit_entries_callback commit_entries_callback_;
+		get_applied_index_handle get_applied_index_handle_;
 
 		snapshot_builder snapshot_builder_;
 		snapshot_writer snapshot_writer_;
 		snapshot_reader snapshot_reader_;
 		build_snapshot_callback build_snapshot_callback_;
+		prepare_snapshot_callback prepare_snapshot_callback_;
 		install_snapshot_callback install_snapshot_callback_;
 
 		raft_config_mgr raft_config_mgr_;
@@ -796,16 +1619,89 @@ namespace xraft
 		state state_;
 		std::mutex mtx_;
 		std::map<int64_t, append_log_callback_info> append_log_callbacks_;
+		std::vector<int64_t> peer_match_indexes_;
+
+		//read index state, rounds count up for the whole life of the node.
+		struct read_request
+		{
+			uint64_t round_;
+			int64_t index_;
+			bool wait_applied_;
+			read_index_callback callback_;
+		};
+		std::mutex read_mtx_;
+		std::atomic_bool leader_term_committed_ = false;
+		uint64_t read_round_sent_ = 0;
+		uint64_t read_round_acked_ = 0;
+		std::vector<uint64_t> peer_read_rounds_;
+		std::list<read_request> read_requests_;
+		std::multimap<int64_t, read_index_callback> read_waiters_;
+		//a follower's read index requests waiting for the leader's reply.
+		struct pending_read_index
+		{
+			int64_t timer_id_;
+			read_index_callback callback_;
+		};
+		std::atomic<uint64_t> read_index_request_id_{ 0 };
+		std::map<uint64_t, pending_read_index> pending_read_indexes_;
+		//lease state, peer acks are steady clock send times in ms.
+		std::atomic_bool lease_read_ = false;
+		int64_t lease_clock_drift_ms_ = 100;
+		std::vector<int64_t> peer_lease_acks_;
+		std::atomic_int64_t lease_expire_ = 0;
+		//send time of the newest AppendEntries a majority acked.
+		std::atomic_int64_t quorum_ack_time_ = 0;
+
+		//follower staleness: the newest leader commit heard, the leader
+		//commits not applied yet with the time each was heard, and the
+		//last time the leader was heard at a commit already applied.
+		std::mutex staleness_mtx_;
+		std::atomic_int64_t leader_commit_seen_ = 0;
+		std::deque<std::pair<int64_t, int64_t>> leader_commits_;
+		std::atomic_int64_t applied_fresh_time_ = 0;
+		//declared before timer_, its ticker flushes it.
+		hard_state hard_state_;
+		int64_t hard_state_flush_interval_ms_ = 100;
 		detail::timer timer_;
+		int64_t timer_tick_ms_ = 10;
+		//builds snapshots off the commit thread, declared before
+		//commiter_ which pushes to it.
+		committer<> snapshot_worker_;
 		committer<> commiter_;
+		std::atomic_int64_t last_snapshot_build_ = 0;
+		int64_t snapshot_min_interval_ms_ = 10000;
+		uint32_t snapshot_codec_ = 0;
+		std::size_t snapshot_block_bytes_ = 64 * 1024;
 
 		metadata<> metadata_;
 		std::string metadata_base_path_;
 
 		detail::filelog log_;
 		std::string filelog_base_path_;
+		std::size_t group_commit_max_bytes_ = 0;
+		int64_t group_commit_max_wait_us_ = 0;
+		std::size_t log_cache_max_bytes_ = 16 * 1024 * 1024;
+		bool async_log_persist_ = false;
+		int64_t local_persisted_index_ = 0;
+		std::size_t append_entries_pipeline_window_ = 1;
 
+		std::mutex propose_mtx_;
+		std::condition_variable propose_cv_;
+		std::vector<proposal> proposals_;
+		std::size_t proposals_bytes_ = 0;
+		std::size_t propose_batch_max_bytes_ = 0;
+		int64_t propose_batch_max_wait_us_ = 0;
+		committer<> proposer_;
 		std::string current_snapshot_;
+		//guards snapshot_writer_ and snapshot_chunks_.
+		std::mutex snapshot_mtx_;
+		int64_t snapshot_writer_index_ = 0;
+		std::map<int64_t, install_snapshot_request> snapshot_chunks_;
+		std::size_t max_snapshot_chunks_ = 64;
+		std::size_t snapshot_chunk_bytes_ = 1024 * 1024;
+		std::size_t snapshot_window_ = 4;
+		int snapshot_channel_port_offset_ = 0;
+		snapshot_channel_server snapshot_channel_;
 		std::string snapshot_base_path_;
 
 		std::vector<vote_response>  vote_responses_;
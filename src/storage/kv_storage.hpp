@@ -70,6 +70,17 @@ namespace timax { namespace db
 			consensus_.del(key);
 		}
 
+		// may be behind the leader, within the consensus staleness bounds
+		std::string get_stale(std::string const& key)
+		{
+			return consensus_.get_stale(key);
+		}
+
+		void set_max_staleness(int64_t max_entries, int64_t max_ms)
+		{
+			consensus_.set_max_staleness(max_entries, max_ms);
+		}
+
 	private:
 		storage_policy		storage_;
 		consensus_policy		consensus_;
@@ -6,125 +6,6 @@
 
 namespace timax { namespace db
 {
-	template <typename SnapshotPtr>
-	class sequence_list
-	{
-	public:
-		static constexpr size_t array_size = 512;
-		static constexpr uint32_t max_array_count = 3;
-		using snapshot_ptr = SnapshotPtr;
-		using array_type = std::array<snapshot_ptr, array_size>;
-
-	public:
-		template <typename F>
-		explicit sequence_list(F&& func)
-			: snapshot_blocks_(1)
-			, log_index_begin_(1)
-			, release_func_(std::forward<F>(func))
-		{
-		}
-
-		~sequence_list()
-		{
-			for (auto& block : snapshot_blocks_)
-			{
-				release(block);
-			}
-		}
-
-		snapshot_ptr get_snapshot(int64_t log_index) const
-		{
-			if (log_index < log_index_begin_)
-				return nullptr;
-
-			log_index -= log_index_begin_;
-			auto advance = log_index / array_size;
-
-			if (advance >= snapshot_blocks_.size())
-				return nullptr;
-
-			auto itr = snapshot_blocks_.begin();
-			if (advance > 0)
-			{
-				std::advance(itr, advance);
-				log_index -= advance * array_size;
-			}
-
-			return (*itr)[log_index];
-		}
-
-		void put_snapshot(int64_t log_index, snapshot_ptr snapshot)
-		{
-			if (log_index < log_index_begin_ || nullptr == snapshot)
-				return;
-
-			auto log_idx = log_index - log_index_begin_;
-			auto advance = log_idx / array_size;
-			log_idx -= advance * array_size;
-
-			auto itr = snapshot_blocks_.begin();
-			if (advance > 0)
-			{
-				std::list<array_type> temp;
-				if (advance >= snapshot_blocks_.size())
-				{
-					temp.resize(advance - snapshot_blocks_.size() + 1);
-					std::move(temp.begin(), temp.end(), std::back_inserter(snapshot_blocks_));
-				}
-				std::advance(itr, advance);
-			}
-
-			(*itr)[log_idx] = snapshot;
-
-			while (advance >= max_array_count)
-			{
-				release(snapshot_blocks_.front());
-				snapshot_blocks_.pop_front();
-				log_index_begin_ += array_size;
-				--advance;
-			}
-		}
-
-		size_t block_size() const noexcept
-		{
-			return snapshot_blocks_.size();
-		}
-
-		int64_t get_begin_log_index() const noexcept
-		{
-			return log_index_begin_;
-		}
-
-		void reset()
-		{
-			for (auto& block : snapshot_blocks_)
-			{
-				release(block);
-			}
-
-			snapshot_blocks_.clear();
-			snapshot_blocks_.resize(1);
-			log_index_begin_ = 1;
-		}
-
-	private:
-		void release(array_type& snapshots)
-		{
-			for (auto snapshot : snapshots)
-			{
-				if (nullptr != snapshot)
-				{
-					release_func_(snapshot);
-				}
-			}
-		}
-
-	private:
-		std::list<array_type>				snapshot_blocks_;
-		int64_t							log_index_begin_;
-		std::function<void(snapshot_ptr)>	release_func_;
-	};
-
 	struct raft_consensus_config
 	{
 		struct raft_node
@@ -155,46 +36,87 @@ namespace timax { namespace db
 	public:
 		using storage_policy = StoragePolicy;
 		using snapshot_ptr = typename storage_policy::snapshot_ptr;
-		using sequence_list_type = sequence_list<snapshot_ptr>;
 
 	public:
 		raft_consensus(storage_policy& storage, std::string const& consensus_config_path)
 			: storage_(storage)
-			, snapshot_blocks_([this](snapshot_ptr snapshot) { storage_.release_snapshot(snapshot); })
+			, applied_index_(storage.get_applied_index())
 		{
 			init(consensus_config_path);
 		}
 
+		~raft_consensus()
+		{
+			std::lock_guard<std::mutex> lock{ snapshot_view_mutex_ };
+			if (nullptr != snapshot_view_)
+				storage_.release_snapshot(snapshot_view_);
+		}
+
 		void put(std::string const& key, std::string const& value)
 		{
 			check_leader();
 			// serialize 'put' 'key' 'value' to a buffer
 			std::string serialized_log;
 			log_serializer::pack_write(serialized_log, key, value);
-			// replicate the log
-			auto log_index = replicate(std::move(serialized_log));
-			put(log_index, key, value);
+			// replicate the log, it is applied on the commit thread
+			replicate(std::move(serialized_log));
 		}
 
+		// linearizable: the leader confirms it still leads, by a heartbeat
+		// round or its lease, and waits until the index committed at the
+		// time of the call is applied.
+		// followers get the read index from the leader and serve the read
+		// once they applied up to it.
 		std::string get(std::string const& key)
 		{
-			check_leader();
+			if (raft_.check_leader())
+				read_index();
+			else
+				wait_applied(get_read_index());
 			return storage_.get(key);
 		}
 
+		// bounded staleness read, answered from the local storage without
+		// any network trip, on the leader and on followers.
+		std::string get_stale(std::string const& key)
+		{
+			if (!raft_.check_staleness(max_stale_entries_, max_stale_ms_))
+				throw std::runtime_error{ "Replica is too stale to serve the read." };
+			return storage_.get(key);
+		}
+
+		// get_stale lag bounds, a negative bound is not checked.
+		void set_max_staleness(int64_t max_entries, int64_t max_ms)
+		{
+			max_stale_entries_ = max_entries;
+			max_stale_ms_ = max_ms;
+		}
+
+		// serve get from the local storage while the leader lease holds,
+		// clock_drift_ms must bound the clock rate difference between nodes.
+		void set_lease_read(bool enable, int64_t clock_drift_ms = 100)
+		{
+			raft_.set_lease_read(enable, clock_drift_ms);
+		}
+
 		void del(std::string const& key)
 		{
 			check_leader();
 			std::string serialized_log;
 			log_serializer::pack_delete(serialized_log, key);
-			auto log_index = replicate(std::move(serialized_log));
-			del(log_index, key);
+			replicate(std::move(serialized_log));
 			// no need for del to write snapshot?
 		}
 
 	private:
 		void init(std::string const& consensus_config_path)
 		{
+			raft_.regist_prepare_snapshot_callback(
+				[this](auto log_index)
+			{
+				prepare_snapshot(log_index);
+			});
+
 			raft_.regist_build_snapshot_callback(
 				[this](auto const& writer, auto log_index)
 			{
@@ -204,37 +126,88 @@ namespace timax { namespace db
 			raft_.regist_install_snapshot_handle(
 				[this](auto& in_stream)
 			{
-				snapshot_blocks_.reset();
+				std::lock_guard<std::mutex> lock{ apply_mutex_ };
 				storage_.install_from_file(in_stream);
+				applied_index_ = storage_.get_applied_index();
+				applied_cv_.notify_all();
+			});
+
+			raft_.regist_commit_entries_callback(
+				[this](auto&& entries)
+			{
+				commit_entries(std::move(entries));
 			});
 
-			raft_.regist_commit_entry_callback(
-				[this](auto&& buffer, auto log_index)
+			raft_.regist_get_applied_index_handle(
+				[this]
 			{
-				commit_entry(std::move(buffer), log_index);
+				std::lock_guard<std::mutex> lock{ apply_mutex_ };
+				return applied_index_;
 			});
 
 			init_raft_config(consensus_config_path);
 		}
 
-		int64_t replicate(std::string&& data)
+		// raft applies every committed entry through commit_entries before
+		// it reports the result, so the write is in the storage on return.
+		void replicate(std::string&& data)
 		{
 			semaphore s;
 			bool result;
-			int64_t log_index;
 
-			raft_.replicate(std::move(data), [&] (bool r, int64_t index)
+			raft_.replicate(std::move(data), [&](bool r, int64_t)
 			{
 				result = r;
-				log_index = index;
 				s.signal();
 			});
 
 			s.wait();
 			if (!result)
 				throw std::runtime_error{ "Failed to replicate log." };
+		}
+
+		void read_index()
+		{
+			semaphore s;
+			bool result;
 
-			return log_index;
+			raft_.read_index([&](bool r, int64_t)
+			{
+				result = r;
+				s.signal();
+			});
+
+			s.wait();
+			if (!result)
+				throw std::runtime_error{ "Failed to confirm leadership for read." };
+		}
+
+		int64_t get_read_index()
+		{
+			semaphore s;
+			bool result;
+			int64_t read_index;
+
+			raft_.get_read_index([&](bool r, int64_t index)
+			{
+				result = r;
+				read_index = index;
+				s.signal();
+			});
+
+			s.wait();
+			if (!result)
+				throw std::runtime_error{ "Failed to get the read index from the leader." };
+
+			return read_index;
+		}
+
+		void wait_applied(int64_t log_index)
+		{
+			std::unique_lock<std::mutex> lock{ apply_mutex_ };
+			if (!applied_cv_.wait_for(lock, std::chrono::milliseconds(read_timeout_),
+				[&] { return applied_index_ >= log_index; }))
+				throw std::runtime_error{ "Timed out waiting for the read index to be applied." };
 		}
 
 		void check_leader()
@@ -243,39 +216,79 @@ namespace timax { namespace db
 				throw std::runtime_error{ "Not a leader" };
 		}
 
-		bool write_snapshot(std::function<bool(const std::string &)> const& writer, int64_t log_index)
+		// runs on the commit thread, so the storage snapshot taken here is the
+		// state at log_index. it is held until the snapshot worker wrote it.
+		// a checkpoint is created by the worker and may be ahead of it.
+		void prepare_snapshot(int64_t log_index)
 		{
-			return storage_.write_snapshot(snapshot_blocks_.get_snapshot(log_index), writer);
+			std::lock_guard<std::mutex> lock{ snapshot_view_mutex_ };
+			if (nullptr != snapshot_view_)
+				storage_.release_snapshot(snapshot_view_);
+			snapshot_view_ = storage_.get_snapshot();
+			snapshot_view_index_ = log_index;
 		}
 
-		void commit_entry(std::string&& buffer, int64_t log_index)
+		bool write_snapshot(std::function<bool(const std::string &)> const& writer, int64_t log_index)
 		{
-			auto db_op = log_serializer::unpack(buffer);
-			if (static_cast<int>(log_op::Write) == db_op.op_type)
-			{
-				put(log_index, db_op.key, db_op.value);
-			}
-			else
+			snapshot_ptr snapshot = nullptr;
 			{
-				del(log_index, db_op.key);
+				std::lock_guard<std::mutex> lock{ snapshot_view_mutex_ };
+				if (snapshot_view_index_ == log_index)
+					std::swap(snapshot, snapshot_view_);
 			}
+			if (nullptr == snapshot)
+				return false;
+
+			// raft drops the log up to log_index once the snapshot is done,
+			// without the wal the applied data must reach the sst files first.
+			storage_.flush();
+			auto result = storage_.write_snapshot(snapshot, writer);
+			storage_.release_snapshot(snapshot);
+			return result;
 		}
 
-		void put(int64_t log_index, std::string const& key, std::string const& value)
+		// a run of committed entries goes into write batches of up to
+		// max_apply_batch_bytes, each one carrying its last log index.
+		// committed entries come in order, the ones at or below the stored
+		// applied index are already in the db. they come again after a
+		// restart or on top of a newer snapshot.
+		void commit_entries(std::list<xraft::detail::log_entry>&& entries)
 		{
-			// we actually commit the key-value
-			storage_.put(key, value);
-
-			// get snapshot
-			auto snapshot = storage_.get_snapshot();
-
-			// cache this snapshot with log_index
-			snapshot_blocks_.put_snapshot(log_index, snapshot);
-		}
-
-		void del(int64_t log_index, std::string const& key)
-		{
-			storage_.del(key);
+			std::lock_guard<std::mutex> lock{ apply_mutex_ };
+			typename storage_policy::write_batch batch;
+			int64_t batch_index = 0;
+			int64_t last_index = 0;
+			for (auto& entry : entries)
+			{
+				if (entry.index_ <= applied_index_)
+					continue;
+				last_index = entry.index_;
+				// the leader's no-op entries only carry their index.
+				if (xraft::detail::log_entry::type::e_append_log != entry.type_)
+					continue;
+
+				auto db_op = log_serializer::unpack(entry.log_data_);
+				if (static_cast<int>(log_op::Write) == db_op.op_type)
+					batch.put(db_op.key, db_op.value);
+				else
+					batch.del(db_op.key);
+				batch_index = entry.index_;
+
+				if (batch.data_size() >= max_apply_batch_bytes)
+				{
+					storage_.write(batch, batch_index);
+					applied_index_ = batch_index;
+					batch.clear();
+				}
+			}
+			// a run that ends in no-ops still stores their index, possibly
+			// with an empty batch, a snapshot may be taken at it.
+			if (last_index > applied_index_)
+			{
+				storage_.write(batch, last_index);
+				applied_index_ = last_index;
+			}
+			applied_cv_.notify_all();
 		}
 
 		void init_raft_config(std::string const& consensus_config_path)
@@ -292,6 +305,7 @@ namespace timax { namespace db
 			auto consensus_config = codec.template unpack<raft_consensus_config>(buffer.data(), buffer.size());
 			xraft::raft::raft_config config_internal;
 			config_internal.append_log_timeout_ = static_cast<size_t>(consensus_config.append_log_timeout);
+			read_timeout_ = static_cast<int64_t>(consensus_config.append_log_timeout);
 			config_internal.election_timeout_ = static_cast<size_t>(consensus_config.election_timeout);
 			config_internal.heartbeat_interval_ = static_cast<size_t>(consensus_config.heartbeat_duration);
 			config_internal.raftlog_base_path_ = consensus_config.log_path;
@@ -312,7 +326,16 @@ namespace timax { namespace db
 
 	private:
 		storage_policy&		storage_;
-		sequence_list_type	snapshot_blocks_;
+		static constexpr size_t	max_apply_batch_bytes = 4 * 1024 * 1024;
+		std::mutex			apply_mutex_;
+		int64_t				applied_index_;
+		std::condition_variable	applied_cv_;
+		int64_t				read_timeout_ = 10000;
+		std::atomic<int64_t>	max_stale_entries_{ 1000 };
+		std::atomic<int64_t>	max_stale_ms_{ 1000 };
+		std::mutex			snapshot_view_mutex_;
+		snapshot_ptr			snapshot_view_ = nullptr;
+		int64_t				snapshot_view_index_ = 0;
 		xraft::raft			raft_;
 	};
 } }
\ No newline at end of file
@@ -1,8 +1,14 @@
 ﻿#pragma once
 
 #include <thread>
+#include <mutex>
+#include <shared_mutex>
 #include <rocksdb/db.h>
 #include <rocksdb/options.h>
+#include <rocksdb/env.h>
+#include <rocksdb/write_batch.h>
+#include <rocksdb/sst_file_writer.h>
+#include <rocksdb/utilities/checkpoint.h>
 #include <functional>
 
 #include "serializer.hpp"
@@ -14,12 +20,77 @@ namespace timax { namespace db
 	public:
 		using snapshot_ptr = rocksdb::Snapshot const*;
 
+		enum class snapshot_mode
+		{
+			iterate,		// every key-value pair of a rocksdb snapshot
+			checkpoint,	// the files of a rocksdb checkpoint
+		};
+
+		// a run of operations written at once with their applied index
+		class write_batch
+		{
+			friend rocksdb_storage;
+		public:
+			void put(std::string const& key, std::string const& value)
+			{
+				batch_.Put(key, value);
+			}
+
+			void del(std::string const& key)
+			{
+				batch_.Delete(key);
+			}
+
+			size_t data_size() const
+			{
+				return batch_.GetDataSize();
+			}
+
+			void clear()
+			{
+				batch_.Clear();
+			}
+
+		private:
+			rocksdb::WriteBatch batch_;
+		};
+
 	public:
 		explicit rocksdb_storage(std::string const& path)
 		{
+			recover_install(path);
 			init(path);
 		}
 
+		void set_snapshot_mode(snapshot_mode mode)
+		{
+			snapshot_mode_ = mode;
+		}
+
+		// the raft log already is the write-ahead log of applied entries.
+		// without the rocksdb wal a crash loses the memtable, together with
+		// the applied index written in the same batches, and raft applies
+		// those entries again.
+		void set_disable_wal(bool disable)
+		{
+			apply_options_.disableWAL = disable;
+		}
+
+		bool is_wal_disabled() const
+		{
+			return apply_options_.disableWAL;
+		}
+
+		// makes the applied data durable when the wal is disabled
+		void flush()
+		{
+			if (!apply_options_.disableWAL)
+				return;
+			auto s = db_->Flush(rocksdb::FlushOptions{});
+			if (!s.ok())
+				throw std::runtime_error{ s.getState() };
+		}
+
 		void put(std::string const& key, std::string const& value)
 		{
 			auto s = db_->Put(rocksdb::WriteOptions{}, key, value);
@@ -34,8 +105,50 @@ namespace timax { namespace db
 				throw std::runtime_error{ s.getState() };
 		}
 
+		// the applied log index goes into the same batch as the data, so the
+		// db and the index it reflects never disagree, in snapshots as well.
+		void put(std::string const& key, std::string const& value, int64_t applied_index)
+		{
+			write_batch batch;
+			batch.put(key, value);
+			write(batch, applied_index);
+		}
+
+		void del(std::string const& key, int64_t applied_index)
+		{
+			write_batch batch;
+			batch.del(key);
+			write(batch, applied_index);
+		}
+
+		void write(write_batch& batch, int64_t applied_index)
+		{
+			put_applied_index(batch.batch_, applied_index);
+			auto s = db_->Write(apply_options_, &batch.batch_);
+			if (!s.ok())
+				throw std::runtime_error{ s.getState() };
+		}
+
+		// 0 when nothing was applied yet
+		int64_t get_applied_index()
+		{
+			std::shared_lock<std::shared_timed_mutex> lock{ db_mutex_ };
+			std::string value;
+			auto s = db_->Get(rocksdb::ReadOptions{}, applied_index_key(), &value);
+			if (s.IsNotFound())
+				return 0;
+			if (!s.ok() || value.size() != sizeof(int64_t))
+				throw std::runtime_error{ "Failed to read the applied index." };
+			int64_t index = 0;
+			std::memcpy(&index, value.data(), sizeof(int64_t));
+			return index;
+		}
+
+		// reads may come from any thread while a snapshot install
+		// reopens the db.
 		std::string get(std::string const& key)
 		{
+			std::shared_lock<std::shared_timed_mutex> lock{ db_mutex_ };
 			std::string value;
 			auto s = db_->Get(rocksdb::ReadOptions{}, key, &value);
 			if (!s.ok())
@@ -43,6 +156,8 @@ namespace timax { namespace db
 			return value;
 		}
 
+		// cheap, it is taken on the commit thread. in checkpoint mode the
+		// checkpoint is only created by write_snapshot.
 		snapshot_ptr get_snapshot()
 		{
 			return db_->GetSnapshot();
@@ -55,6 +170,9 @@ namespace timax { namespace db
 
 		bool write_snapshot(snapshot_ptr snapshot, std::function<bool(std::string const&)> const& writer)
 		{
+			if (snapshot_mode::checkpoint == snapshot_mode_)
+				return write_checkpoint(snapshot, writer);
+
 			if (nullptr == snapshot)
 				return false;
 
@@ -82,8 +200,16 @@ namespace timax { namespace db
 			return true;
 		}
 
-		void install_from_file(std::ifstream& in_stream)
+		void install_from_file(std::istream& in_stream)
 		{
+			std::unique_lock<std::shared_timed_mutex> lock{ db_mutex_ };
+			std::vector<checkpoint_serializer::file_entry> files;
+			if (checkpoint_serializer::unpack_manifest(in_stream, files))
+			{
+				install_checkpoint(in_stream, files);
+				return;
+			}
+
 			auto db_name = db_->GetName();
 			db_.reset();
 			auto s = rocksdb::DestroyDB(db_name, rocksdb::Options{});
@@ -91,28 +217,251 @@ namespace timax { namespace db
 				throw std::runtime_error{ "Failed to destroy the rocksdb." };
 
 			init(db_name);
+			ingest_key_values(in_stream);
+		}
+
+	private:
+		// reserved, user keys must not start with a zero byte
+		static std::string const& applied_index_key()
+		{
+			static std::string const key{ "\0" "xraft.applied_index", 20 };
+			return key;
+		}
 
-			std::string key, value;
+		static void put_applied_index(rocksdb::WriteBatch& batch, int64_t applied_index)
+		{
+			batch.Put(applied_index_key(), rocksdb::Slice{ 
+				reinterpret_cast<char const*>(&applied_index), sizeof(int64_t) });
+		}
+
+		std::string checkpoint_dir() const
+		{
+			return db_->GetName() + ".checkpoint";
+		}
+
+		// the checkpoint hard links the live sst files, so taking it costs
+		// no data copy, only a memtable flush.
+		bool create_checkpoint(std::string const& dir)
+		{
+			remove_dir(dir);
+			rocksdb::Checkpoint* checkpoint_raw = nullptr;
+			auto s = rocksdb::Checkpoint::Create(db_.get(), &checkpoint_raw);
+			if (!s.ok())
+				return false;
+			std::unique_ptr<rocksdb::Checkpoint> checkpoint{ checkpoint_raw };
+			return checkpoint->CreateCheckpoint(dir).ok();
+		}
+
+		// the checkpoint is created here, off the commit thread, so it may
+		// be ahead of the snapshot's log index. it carries its own applied
+		// index, the entries at or below it are skipped when raft applies
+		// them again after an install.
+		bool write_checkpoint(snapshot_ptr snapshot, std::function<bool(std::string const&)> const& writer)
+		{
+			std::lock_guard<std::mutex> lock{ checkpoint_mutex_ };
+			auto checkpoint_dir = this->checkpoint_dir();
+			if (nullptr == snapshot || !create_checkpoint(checkpoint_dir))
+			{
+				remove_dir(checkpoint_dir);
+				return false;
+			}
+
+			auto env = rocksdb::Env::Default();
+			std::vector<checkpoint_serializer::file_entry> files;
+			for (auto const& name : list_dir(checkpoint_dir))
+			{
+				uint64_t size = 0;
+				if (!env->GetFileSize(checkpoint_dir + "/" + name, &size).ok())
+					return false;
+				files.push_back({ name, size });
+			}
+
+			std::string buffer;
+			checkpoint_serializer::pack_manifest(files, buffer);
+			auto result = writer(buffer);
+			for (auto itr = files.begin(); result && itr != files.end(); ++itr)
+			{
+				std::ifstream file{ checkpoint_dir + "/" + itr->name, std::ios::binary };
+				result = copy_bytes(file, itr->size, writer);
+			}
+			remove_dir(checkpoint_dir);
+			return result;
+		}
+
+		// unpack the files next to the db, then swap the directories
+		void install_checkpoint(std::istream& in_stream, 
+			std::vector<checkpoint_serializer::file_entry> const& files)
+		{
+			auto env = rocksdb::Env::Default();
+			auto db_name = db_->GetName();
+			auto install_dir = db_name + ".install";
+			remove_dir(install_dir);
+			if (!env->CreateDir(install_dir).ok())
+				throw std::runtime_error{ "Failed to create " + install_dir };
+
+			// the files and the directory entries must be durable before
+			// the rename makes them the db.
+			for (auto const& file : files)
+			{
+				std::unique_ptr<rocksdb::WritableFile> out;
+				if (!env->NewWritableFile(install_dir + "/" + file.name, &out, rocksdb::EnvOptions{}).ok())
+					throw std::runtime_error{ "Failed to create " + file.name };
+				auto result = copy_bytes(in_stream, file.size, [&out](std::string const& buffer)
+				{
+					return out->Append(buffer).ok();
+				});
+				if (!result || !out->Fsync().ok() || !out->Close().ok())
+					throw std::runtime_error{ "Failed to install " + file.name };
+			}
+			sync_dir(install_dir);
+
+			auto old_dir = db_name + ".old";
+			remove_dir(old_dir);
+			db_.reset();
+			if (!env->RenameFile(db_name, old_dir).ok() || 
+				!env->RenameFile(install_dir, db_name).ok())
+				throw std::runtime_error{ "Failed to swap the rocksdb directory." };
+			sync_dir(parent_dir(db_name));
+
+			init(db_name);
+			remove_dir(old_dir);
+		}
+
+		static void sync_dir(std::string const& dir)
+		{
+			std::unique_ptr<rocksdb::Directory> directory;
+			if (!rocksdb::Env::Default()->NewDirectory(dir, &directory).ok() ||
+				!directory->Fsync().ok())
+				throw std::runtime_error{ "Failed to sync " + dir };
+		}
+
+		static std::string parent_dir(std::string const& path)
+		{
+			auto pos = path.find_last_of("/\\");
+			if (std::string::npos == pos)
+				return ".";
+			if (pos + 1 == path.size())
+				return parent_dir(path.substr(0, pos));
+			return path.substr(0, pos);
+		}
+
+		// write the key-value stream into external sst files and ingest them,
+		// which skips the wal and the memtable. the stream comes sorted from
+		// write_snapshot, a key out of order ingests the files written so far
+		// and starts new ones, so later pairs still win.
+		void ingest_key_values(std::istream& in_stream)
+		{
+			auto env = rocksdb::Env::Default();
+			auto ingest_dir = db_->GetName() + ".ingest";
+			remove_dir(ingest_dir);
+			if (!env->CreateDir(ingest_dir).ok())
+				throw std::runtime_error{ "Failed to create " + ingest_dir };
+
+			auto check = [](rocksdb::Status const& s)
+			{
+				if (!s.ok())
+					throw std::runtime_error{ s.getState() };
+			};
+
+			std::unique_ptr<rocksdb::SstFileWriter> sst_writer;
+			std::vector<std::string> files;
+			auto finish_file = [&]
+			{
+				if (sst_writer)
+					check(sst_writer->Finish());
+				sst_writer.reset();
+			};
+			auto ingest = [&]
+			{
+				finish_file();
+				if (files.empty())
+					return;
+				rocksdb::IngestExternalFileOptions options;
+				options.move_files = true;
+				check(db_->IngestExternalFile(files, options));
+				files.clear();
+			};
+
+			std::string key, value, last_key;
+			size_t file_count = 0;
 			while (snapshot_serializer::unpack(in_stream, key, value))
 			{
-				//std::cout << key << " - " << value << std::endl;
-				put(key, value);
+				if (!files.empty() && key <= last_key)
+					ingest();
+				if (sst_writer && sst_writer->FileSize() >= sst_file_size)
+					finish_file();
+				if (!sst_writer)
+				{
+					sst_writer.reset(new rocksdb::SstFileWriter{ rocksdb::EnvOptions{}, options_ });
+					files.push_back(ingest_dir + "/" + std::to_string(file_count++) + ".sst");
+					check(sst_writer->Open(files.back()));
+				}
+				check(sst_writer->Put(key, value));
+				last_key.swap(key);
 			}
+			ingest();
+			remove_dir(ingest_dir);
+		}
+
+		// a crash between the two renames of install_checkpoint, and a
+		// checkpoint left by a snapshot that never finished
+		void recover_install(std::string const& path)
+		{
+			auto env = rocksdb::Env::Default();
+			if (env->FileExists(path).IsNotFound() && env->FileExists(path + ".old").ok())
+				env->RenameFile(path + ".old", path);
+			remove_dir(path + ".checkpoint");
+		}
+
+		template <typename Writer>
+		static bool copy_bytes(std::istream& in_stream, uint64_t size, Writer&& writer)
+		{
+			std::string buffer;
+			while (size > 0)
+			{
+				buffer.resize(static_cast<size_t>(std::min<uint64_t>(size, copy_buffer_size)));
+				in_stream.read(&buffer[0], buffer.size());
+				if (static_cast<size_t>(in_stream.gcount()) != buffer.size() || !writer(buffer))
+					return false;
+				size -= buffer.size();
+			}
+			return true;
+		}
+
+		static std::vector<std::string> list_dir(std::string const& dir)
+		{
+			std::vector<std::string> children, files;
+			rocksdb::Env::Default()->GetChildren(dir, &children);
+			for (auto& name : children)
+			{
+				if (name != "." && name != "..")
+					files.push_back(std::move(name));
+			}
+			return files;
+		}
+
+		static void remove_dir(std::string const& dir)
+		{
+			auto env = rocksdb::Env::Default();
+			if (!env->FileExists(dir).ok())
+				return;
+			for (auto const& name : list_dir(dir))
+				env->DeleteFile(dir + "/" + name);
+			env->DeleteDir(dir);
 		}
 
-	private:
 		void init(std::string const& path)
 		{
 			rocksdb::Status s;
 
-			rocksdb::Options op;
-			op.IncreaseParallelism(std::thread::hardware_concurrency());
-			op.OptimizeLevelStyleCompaction();
-			op.create_if_missing = true;
-			op.compression_per_level.resize(2);
+			options_ = rocksdb::Options{};
+			options_.IncreaseParallelism(std::thread::hardware_concurrency());
+			options_.OptimizeLevelStyleCompaction();
+			options_.create_if_missing = true;
+			options_.compression_per_level.resize(2);
 
 			rocksdb::DB* db_raw = nullptr;
-			s = rocksdb::DB::Open(op, path, &db_raw);
+			s = rocksdb::DB::Open(options_, path, &db_raw);
 			if (rocksdb::Status::OK() != s)
 			{
 				throw std::runtime_error{ s.getState() };
@@ -122,6 +471,14 @@ namespace timax { namespace db
 		}
 
 	private:
+		static constexpr uint64_t		copy_buffer_size = 1024 * 1024;
+		static constexpr uint64_t		sst_file_size = 256 * 1024 * 1024;
+		rocksdb::Options				options_;
+		rocksdb::WriteOptions			apply_options_;
 		std::unique_ptr<rocksdb::DB>	db_;
+		// readers share it, an install that swaps db_ takes it alone
+		std::shared_timed_mutex			db_mutex_;
+		snapshot_mode					snapshot_mode_ = snapshot_mode::iterate;
+		std::mutex						checkpoint_mutex_;
 	};
 } }
\ No newline at end of file
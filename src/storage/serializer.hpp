@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 namespace timax { namespace db
 {
@@ -130,7 +131,7 @@ namespace timax { namespace db
 			std::memcpy(&value[0], work_ptr, size_value);
 		}
 
-		static bool unpack(std::ifstream& in_stream, std::string& key, std::string& value)
+		static bool unpack(std::istream& in_stream, std::string& key, std::string& value)
 		{
 			uint32_t size = 0;
 			in_stream.read(reinterpret_cast<char*>(&size), sizeof(uint32_t));
@@ -154,4 +155,66 @@ namespace timax { namespace db
 			return true;
 		}
 	};
+
+	struct checkpoint_serializer
+	{
+		struct file_entry
+		{
+			std::string name;
+			uint64_t size;
+		};
+
+		// a key-value snapshot never starts with a zero key size
+		static constexpr uint32_t marker = 0;
+		static constexpr uint32_t magic = 'C' << 24 | 'K' << 16 | 'P' << 8 | 'T';
+
+		static void pack_manifest(std::vector<file_entry> const& files, std::string& buffer)
+		{
+			buffer.clear();
+			append(buffer, marker);
+			append(buffer, magic);
+			append(buffer, static_cast<uint32_t>(files.size()));
+			for (auto const& file : files)
+			{
+				append(buffer, static_cast<uint32_t>(file.name.size()));
+				buffer.append(file.name);
+				append(buffer, file.size);
+			}
+		}
+
+		// true if the stream holds a checkpoint, otherwise the stream is left
+		// where it was
+		static bool unpack_manifest(std::istream& in_stream, std::vector<file_entry>& files)
+		{
+			auto pos = in_stream.tellg();
+			uint32_t head[3] = { 0 };
+			in_stream.read(reinterpret_cast<char*>(head), sizeof(head));
+			if (in_stream.gcount() != sizeof(head) || marker != head[0] || magic != head[1])
+			{
+				in_stream.clear();
+				in_stream.seekg(pos);
+				return false;
+			}
+
+			files.resize(head[2]);
+			for (auto& file : files)
+			{
+				uint32_t size = 0;
+				in_stream.read(reinterpret_cast<char*>(&size), sizeof(uint32_t));
+				file.name.resize(size);
+				in_stream.read(&file.name[0], size);
+				in_stream.read(reinterpret_cast<char*>(&file.size), sizeof(uint64_t));
+				if (!in_stream.good())
+					throw std::runtime_error{ "Bad checkpoint manifest." };
+			}
+			return true;
+		}
+
+	private:
+		template <typename T>
+		static void append(std::string& buffer, T value)
+		{
+			buffer.append(reinterpret_cast<char const*>(&value), sizeof(T));
+		}
+	};
 } }
\ No newline at end of file
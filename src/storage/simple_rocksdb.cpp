@@ -22,19 +22,24 @@ int main(int argc, char* argv[])
 	using timax::rpc::exception;
 	using timax::rpc::error_code;
 
-	if (argc != 4)
-		std::cerr << "Usage: kvcarbin <port-number> <db_path-string> <config_path-string>";
+	if (argc != 4 && argc != 5)
+		std::cerr << "Usage: kvcarbin <port-number> <db_path-string> <config_path-string> [rpc-threads]";
 
 	auto port = boost::lexical_cast<uint16_t>(argv[1]);
 	std::string db_path = argv[2];
 	std::string config_path = argv[3];
+	// put and del hold a worker until the entry commits, the rpc server can
+	// only answer from a handler's return value. more workers than cores
+	// keep more writes in flight.
+	unsigned rpc_threads = argc > 4 ? boost::lexical_cast<unsigned>(argv[4]) :
+		std::thread::hardware_concurrency();
 
 	// initialize our db object
 	//db_type db{ "d:/temp/tmp/test_rocksdb", "raft_config.txt" };
 	db_type db{ db_path, config_path };
 
 	// instantialize our server object
-	server_type kv_store_service{ port, std::thread::hardware_concurrency() };
+	server_type kv_store_service{ port, rpc_threads };
 
 	// register put operation
 	kv_store_service.register_handler("put", 
@@ -66,6 +71,21 @@ int main(int argc, char* argv[])
 		}
 	});
 
+	// register bounded staleness get operation
+	kv_store_service.register_handler("get_stale", 
+		[&db](std::string const& key) -> std::string
+	{
+		try
+		{
+			return db.get_stale(key);
+		}
+		catch (std::exception const& e)
+		{
+			std::cout << e.what() << std::endl;
+			throw exception{ error_code::FAIL, e.what() };
+		}
+	});
+
 	// register del operation
 	kv_store_service.register_handler("del",
 		[&db](std::string const& key)
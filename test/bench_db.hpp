@@ -0,0 +1,119 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+
+namespace bench_db_detail
+{
+	using namespace std::chrono;
+	using db_type = timax::db::rocksdb_storage;
+
+	std::string const bench_db_path = test_base_path + "bench_db";
+	std::string const snapshot_file = test_base_path + "bench_db.ss";
+
+	std::string make_key(int64_t index)
+	{
+		char buffer[32];
+		std::snprintf(buffer, sizeof(buffer), "key%016lld", static_cast<long long>(index));
+		return buffer;
+	}
+
+	//a key-value snapshot as write_snapshot produces it, sorted by key.
+	void make_snapshot_file(int64_t keys)
+	{
+		std::ofstream out{ snapshot_file, std::ios::binary | std::ios::trunc };
+		std::string value(100, 'v'), buffer;
+		for (int64_t loop = 0; loop < keys; ++loop)
+		{
+			timax::db::snapshot_serializer::pack(make_key(loop), value, buffer);
+			out.write(buffer.data(), buffer.size());
+		}
+	}
+
+	//what install_from_file used to do: one put per key.
+	int64_t install_by_put(db_type& db)
+	{
+		auto begin = high_resolution_clock::now();
+		std::ifstream in{ snapshot_file, std::ios::binary };
+		std::string key, value;
+		while (timax::db::snapshot_serializer::unpack(in, key, value))
+			db.put(key, value);
+		return duration_cast<milliseconds>(high_resolution_clock::now() - begin).count();
+	}
+
+	int64_t install_by_ingest(db_type& db)
+	{
+		auto begin = high_resolution_clock::now();
+		std::ifstream in{ snapshot_file, std::ios::binary };
+		db.install_from_file(in);
+		return duration_cast<milliseconds>(high_resolution_clock::now() - begin).count();
+	}
+}
+
+void bench_db_install(int64_t keys)
+{
+	std::cout << "bench_db_install keys(" << keys << ")" << std::endl;
+	using namespace bench_db_detail;
+	make_snapshot_file(keys);
+	{
+		db_type db{ bench_db_path + "_put" };
+		auto elapsed = install_by_put(db);
+		std::cout << "	put per key(" << elapsed << " ms) "
+			<< (keys * 1000 / (elapsed ? elapsed : 1)) << " keys/s\n";
+	}
+	{
+		db_type db{ bench_db_path + "_ingest" };
+		auto elapsed = install_by_ingest(db);
+		std::cout << "	sst ingestion(" << elapsed << " ms) "
+			<< (keys * 1000 / (elapsed ? elapsed : 1)) << " keys/s\n";
+		if (db.get(make_key(keys - 1)) != std::string(100, 'v'))
+			std::cout << "bench_db_install failed!" << std::endl;
+	}
+	std::remove(snapshot_file.c_str());
+}
+
+//one put per committed entry against write batches of about 4 MB.
+void bench_db_apply(int64_t entries, bool disable_wal)
+{
+	std::cout << "bench_db_apply entries(" << entries << ") wal("
+		<< (disable_wal ? "off" : "on") << ")" << std::endl;
+	using namespace bench_db_detail;
+	std::string value(100, 'v');
+	{
+		db_type db{ bench_db_path + "_apply_put" };
+		db.set_disable_wal(disable_wal);
+		auto begin = high_resolution_clock::now();
+		for (int64_t loop = 1; loop <= entries; ++loop)
+			db.put(make_key(loop), value, loop);
+		auto elapsed = duration_cast<milliseconds>(high_resolution_clock::now() - begin).count();
+		std::cout << "	put per entry(" << elapsed << " ms) "
+			<< (entries * 1000 / (elapsed ? elapsed : 1)) << " entries/s\n";
+	}
+	{
+		db_type db{ bench_db_path + "_apply_batch" };
+		db.set_disable_wal(disable_wal);
+		auto begin = high_resolution_clock::now();
+		db_type::write_batch batch;
+		for (int64_t loop = 1; loop <= entries; ++loop)
+		{
+			batch.put(make_key(loop), value);
+			if (batch.data_size() >= 4 * 1024 * 1024 || loop == entries)
+			{
+				db.write(batch, loop);
+				batch.clear();
+			}
+		}
+		auto elapsed = duration_cast<milliseconds>(high_resolution_clock::now() - begin).count();
+		std::cout << "	write batch(" << elapsed << " ms) "
+			<< (entries * 1000 / (elapsed ? elapsed : 1)) << " entries/s\n";
+		if (db.get_applied_index() != entries)
+			std::cout << "bench_db_apply failed!" << std::endl;
+	}
+}
+
+void bench_db()
+{
+	bench_db_apply(1000000, false);
+	bench_db_apply(1000000, true);
+	bench_db_install(10000000);
+	bench_db_install(20000000);
+}
@@ -0,0 +1,203 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+namespace bench_filelog_detail
+{
+	using namespace std::chrono;
+	using filelog_type = xraft::detail::filelog;
+
+	std::string const filelog_path = test_base_path + "bench_filelog/";
+
+	void clear_filelog_dir()
+	{
+		xraft::functors::fs::mkdir()(filelog_path);
+		for (auto const& file : xraft::functors::fs::ls_files()(filelog_path))
+			xraft::functors::fs::rm()(file);
+	}
+
+	//get_log_entry before the in-memory index: a scan over the segments,
+	//then a seek and read on .index and on the data file per entry.
+	struct stream_segment
+	{
+		int64_t log_start_ = 0;
+		int64_t entries_ = 0;
+		std::ifstream data_file_;
+		std::ifstream index_file_;
+	};
+
+	std::vector<stream_segment> open_stream_segments()
+	{
+		std::vector<stream_segment> segments;
+		for (auto const& file : xraft::functors::fs::ls_files()(filelog_path))
+		{
+			auto pos = file.rfind(".log");
+			if (pos == std::string::npos || pos + 4 != file.size())
+				continue;
+			stream_segment segment;
+			segment.data_file_.open(file, std::ios::binary | std::ios::in);
+			segment.index_file_.open(file.substr(0, pos) + ".index", std::ios::binary | std::ios::in);
+			segment.index_file_.seekg(0, std::ios::end);
+			segment.entries_ = (int64_t)segment.index_file_.tellg() / (int64_t)(sizeof(int64_t) * 2);
+			segment.index_file_.seekg(0, std::ios::beg);
+			segment.index_file_.read((char*)&segment.log_start_, sizeof(int64_t));
+			if (segment.entries_)
+				segments.emplace_back(std::move(segment));
+		}
+		std::sort(segments.begin(), segments.end(), [](auto const& left, auto const& right)
+		{
+			return left.log_start_ < right.log_start_;
+		});
+		return segments;
+	}
+
+	bool stream_get_entry(std::vector<stream_segment>& segments, int64_t index, xraft::detail::log_entry& entry)
+	{
+		for (auto& segment : segments)
+		{
+			if (index < segment.log_start_ || index >= segment.log_start_ + segment.entries_)
+				continue;
+			int64_t data_file_offset = 0;
+			auto diff = index - segment.log_start_;
+			if (diff)
+			{
+				int64_t buffer[2] = { 0 };
+				segment.index_file_.clear();
+				segment.index_file_.seekg(diff * sizeof(int64_t) * 2, std::ios::beg);
+				segment.index_file_.read((char*)buffer, sizeof(buffer));
+				if (!segment.index_file_.good() || buffer[0] != index)
+					return false;
+				data_file_offset = buffer[1];
+			}
+			uint32_t len = 0;
+			segment.data_file_.clear();
+			segment.data_file_.seekg(data_file_offset, std::ios::beg);
+			segment.data_file_.read((char*)&len, sizeof(len));
+			std::string buffer;
+			buffer.resize(len);
+			segment.data_file_.read((char*)buffer.data(), len);
+			if (!segment.data_file_.good())
+				return false;
+			entry.from_string(buffer);
+			return true;
+		}
+		return false;
+	}
+
+	void run_group_commit(std::size_t threads, std::size_t max_batch_bytes, int64_t max_wait_us)
+	{
+		const std::size_t writes_per_thread = 1000;
+		clear_filelog_dir();
+		filelog_type log;
+		log.init(filelog_path);
+		log.set_group_commit(max_batch_bytes, max_wait_us);
+
+		std::atomic<int64_t> total_latency_us{ 0 };
+		std::vector<std::thread> writers;
+		auto begin = high_resolution_clock::now();
+		for (std::size_t i = 0; i < threads; ++i)
+		{
+			writers.emplace_back([&]
+			{
+				for (std::size_t loop = 0; loop < writes_per_thread; ++loop)
+				{
+					xraft::detail::log_entry entry;
+					entry.term_ = 1;
+					entry.log_data_.resize(128, 'x');
+					int64_t index = 0;
+					auto start = high_resolution_clock::now();
+					log.write(std::move(entry), index);
+					total_latency_us += duration_cast<microseconds>(
+						high_resolution_clock::now() - start).count();
+				}
+			});
+		}
+		for (auto& writer : writers)
+			writer.join();
+		auto elapsed = duration_cast<microseconds>(high_resolution_clock::now() - begin).count();
+		auto writes = threads * writes_per_thread;
+
+		std::cout << "	threads(" << threads
+			<< ") batch_bytes(" << max_batch_bytes
+			<< ") wait_us(" << max_wait_us
+			<< ") throughput(" << (writes * 1000000 / (elapsed ? elapsed : 1)) << " writes/s)"
+			<< " avg_latency(" << (total_latency_us / (int64_t)writes) << " us)\n";
+	}
+}
+
+void bench_filelog_group_commit()
+{
+	std::cout << "bench_filelog_group_commit" << std::endl;
+	using namespace bench_filelog_detail;
+	for (std::size_t threads : { 1, 4, 16 })
+	{
+		run_group_commit(threads, 0, 0);
+		run_group_commit(threads, 64 * 1024, 0);
+		run_group_commit(threads, 64 * 1024, 200);
+		run_group_commit(threads, 256 * 1024, 1000);
+	}
+	clear_filelog_dir();
+}
+
+void bench_filelog_lookup()
+{
+	std::cout << "bench_filelog_lookup" << std::endl;
+	using namespace bench_filelog_detail;
+	const int64_t entries = 20000;
+	const int64_t lookups = 100000;
+	clear_filelog_dir();
+	{
+		filelog_type log;
+		log.init(filelog_path);
+		// keep lookups off the cached tail
+		log.set_cache_max_bytes(0);
+		for (int64_t loop = 0; loop < entries; ++loop)
+		{
+			xraft::detail::log_entry entry;
+			entry.term_ = 1;
+			entry.log_data_.resize(128, 'x');
+			int64_t index = 0;
+			log.write(std::move(entry), index);
+		}
+
+		std::mt19937 gen(1);
+		std::uniform_int_distribution<int64_t> dis(1, entries);
+		auto begin = high_resolution_clock::now();
+		for (int64_t loop = 0; loop < lookups; ++loop)
+		{
+			xraft::detail::log_entry entry;
+			log.get_log_entry(dis(gen), entry);
+		}
+		auto elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - begin).count();
+		std::cout << "	in-memory index: entries(" << entries
+			<< ") index_memory(" << log.get_index_bytes() << " bytes)"
+			<< " get_log_entry(" << elapsed / lookups << " ns)\n";
+	}
+
+	//the same lookups on the same segments through the old stream path.
+	auto segments = open_stream_segments();
+	std::mt19937 gen(1);
+	std::uniform_int_distribution<int64_t> dis(1, entries);
+	int64_t misses = 0;
+	auto begin = high_resolution_clock::now();
+	for (int64_t loop = 0; loop < lookups; ++loop)
+	{
+		xraft::detail::log_entry entry;
+		if (!stream_get_entry(segments, dis(gen), entry))
+			++misses;
+	}
+	auto elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - begin).count();
+	std::cout << "	stream index: segments(" << segments.size()
+		<< ") misses(" << misses << ")"
+		<< " get_log_entry(" << elapsed / lookups << " ns)\n";
+	segments.clear();
+	clear_filelog_dir();
+}
+
+void bench_filelog()
+{
+	bench_filelog_group_commit();
+	bench_filelog_lookup();
+}
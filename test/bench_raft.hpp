@@ -0,0 +1,115 @@
+#pragma once
+#include <chrono>
+#include <future>
+#include <thread>
+
+namespace bench_raft_detail
+{
+	using namespace std::chrono;
+
+	std::string const raft_path = test_base_path + "bench_raft/";
+	int const base_port = 9100;
+	int const nodes = 3;
+
+	xraft::raft::raft_config make_config(int node)
+	{
+		auto path = raft_path + std::to_string(base_port + node) + "/";
+		xraft::raft::raft_config config;
+		config.append_log_timeout_ = 10000;
+		config.election_timeout_ = 1000;
+		config.heartbeat_interval_ = 300;
+		config.raftlog_base_path_ = path + "log/";
+		config.snapshot_base_path_ = path + "snapshot/";
+		config.metadata_base_path_ = path + "metadata/";
+		for (int i = 0; i < nodes; ++i)
+		{
+			xraft::raft::raft_config::raft_node raft_node{ "127.0.0.1",
+				base_port + i, std::to_string(base_port + i) };
+			if (i == node)
+				config.myself_ = raft_node;
+			else
+				config.peers_.push_back(raft_node);
+		}
+		return config;
+	}
+
+	void run_propose(xraft::raft &leader, std::size_t threads,
+		std::size_t max_batch_bytes, int64_t max_wait_us)
+	{
+		const std::size_t proposals_per_thread = 500;
+		leader.set_propose_batch(max_batch_bytes, max_wait_us);
+
+		std::atomic<std::size_t> failed{ 0 };
+		std::vector<std::thread> proposers;
+		auto begin = high_resolution_clock::now();
+		for (std::size_t i = 0; i < threads; ++i)
+		{
+			proposers.emplace_back([&]
+			{
+				for (std::size_t loop = 0; loop < proposals_per_thread; ++loop)
+				{
+					std::promise<bool> done;
+					leader.replicate(std::string(128, 'x'), [&](bool result, int64_t) {
+						done.set_value(result);
+					});
+					if (!done.get_future().get())
+						++failed;
+				}
+			});
+		}
+		for (auto& proposer : proposers)
+			proposer.join();
+		auto elapsed = duration_cast<microseconds>(high_resolution_clock::now() - begin).count();
+		auto proposals = threads * proposals_per_thread;
+
+		std::cout << "	threads(" << threads
+			<< ") batch_bytes(" << max_batch_bytes
+			<< ") wait_us(" << max_wait_us
+			<< ") throughput(" << (proposals * 1000000 / (elapsed ? elapsed : 1)) << " proposals/s)"
+			<< " failed(" << failed << ")\n";
+	}
+}
+
+void bench_raft_propose()
+{
+	std::cout << "bench_raft_propose" << std::endl;
+	using namespace bench_raft_detail;
+	std::vector<std::unique_ptr<xraft::raft>> rafts;
+	for (int i = 0; i < nodes; ++i)
+	{
+		rafts.emplace_back(new xraft::raft);
+		auto &node = *rafts.back();
+		node.regist_commit_entry_callback([](std::string &&, int64_t) {});
+		node.regist_build_snapshot_callback([](auto const&, int64_t) { return true; });
+		node.regist_install_snapshot_handle([](std::istream &) {});
+		node.init(make_config(i));
+	}
+
+	xraft::raft *leader = nullptr;
+	for (int loop = 0; loop < 100 && !leader; ++loop)
+	{
+		std::this_thread::sleep_for(milliseconds(100));
+		for (auto &node : rafts)
+			if (node->check_leader())
+				leader = node.get();
+	}
+	if (!leader)
+		std::cout << "bench_raft_propose failed! no leader elected" << std::endl;
+	for (std::size_t threads : { 1, 4, 16 })
+	{
+		if (!leader)
+			break;
+		run_propose(*leader, threads, 0, 0);
+		run_propose(*leader, threads, 64 * 1024, 0);
+		run_propose(*leader, threads, 64 * 1024, 200);
+		run_propose(*leader, threads, 256 * 1024, 1000);
+	}
+	//raft can not be torn down cleanly yet, keep the cluster alive.
+	for (auto &node : rafts)
+		node.release();
+}
+
+void bench_raft()
+{
+	bench_raft_propose();
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <chrono>
+#include <random>
+
+namespace bench_timer_detail
+{
+	using namespace std::chrono;
+
+	//set and cancel of the multimap timer detail::timer used to be.
+	class multimap_timer
+	{
+	public:
+		int64_t set_timer(int64_t timeout, std::function<void()> &&callback)
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			auto timer_point = high_resolution_clock::now()
+				+ high_resolution_clock::duration(milliseconds(timeout));
+			auto timer_id = ++timer_id_;
+			actions_.emplace(std::piecewise_construct,
+				std::forward_as_tuple(timer_point),
+				std::forward_as_tuple(timer_id, std::move(callback)));
+			return timer_id;
+		}
+		void cancel(int64_t timer_id)
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			for (auto itr = actions_.begin(); itr != actions_.end(); itr++)
+			{
+				if (itr->second.first == timer_id)
+				{
+					actions_.erase(itr);
+					return;
+				}
+			}
+		}
+	private:
+		std::mutex mtx_;
+		int64_t timer_id_ = 1;
+		std::multimap<high_resolution_clock::time_point,
+			std::pair<int64_t, std::function<void()>>> actions_;
+	};
+
+	template<typename timer_type>
+	void run_set_cancel(const char *name, timer_type &timer, std::size_t outstanding)
+	{
+		std::vector<int64_t> ids;
+		ids.reserve(outstanding);
+		auto begin = high_resolution_clock::now();
+		for (std::size_t i = 0; i < outstanding; ++i)
+			ids.push_back(timer.set_timer(10000 + (int64_t)(i % 1000), [] {}));
+		auto set_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - begin).count();
+
+		std::shuffle(ids.begin(), ids.end(), std::mt19937(1));
+		begin = high_resolution_clock::now();
+		for (auto id : ids)
+			timer.cancel(id);
+		auto cancel_elapsed = duration_cast<nanoseconds>(high_resolution_clock::now() - begin).count();
+
+		std::cout << "	" << name << " outstanding(" << outstanding
+			<< ") set(" << set_elapsed / (int64_t)outstanding << " ns)"
+			<< " cancel(" << cancel_elapsed / (int64_t)outstanding << " ns)\n";
+	}
+}
+
+void bench_timer_set_cancel()
+{
+	std::cout << "bench_timer_set_cancel" << std::endl;
+	using namespace bench_timer_detail;
+	for (std::size_t outstanding : { 100, 1000, 10000 })
+	{
+		multimap_timer old_timer;
+		run_set_cancel("multimap", old_timer, outstanding);
+		xraft::detail::timer wheel_timer;
+		run_set_cancel("timing wheel", wheel_timer, outstanding);
+	}
+}
+
+void bench_timer()
+{
+	bench_timer_set_cancel();
+}
@@ -123,6 +123,7 @@ void test_snapshot_traverse()
 	try
 	{
 		db_type db{ "d:/temp/tmp/test_db" };
+		db.set_snapshot_mode(db_type::snapshot_mode::iterate);
 		detail::prepare_data(db);
 
 		std::cout << "	Traverse throw snapshot iterator....\n";
@@ -147,10 +148,92 @@ void test_snapshot_traverse()
 	}
 }
 
+void test_snapshot_checkpoint()
+{
+	std::cout << "test_snapshot_checkpoint" << std::endl;
+	try
+	{
+		std::string snapshot_file = "d:/temp/tmp/test_db_checkpoint.ss";
+		{
+			db_type db{ "d:/temp/tmp/test_db" };
+			db.set_snapshot_mode(db_type::snapshot_mode::checkpoint);
+			detail::prepare_data(db);
+			auto snapshot = db.get_snapshot();
+			// the checkpoint is created by write_snapshot, so it has this too
+			db.put("after_checkpoint", "timax");
+			std::ofstream out{ snapshot_file, std::ios::binary | std::ios::trunc };
+			auto result = db.write_snapshot(snapshot, [&out](std::string const& buffer)
+			{
+				out.write(buffer.data(), buffer.size());
+				return out.good();
+			});
+			db.release_snapshot(snapshot);
+			db.del("after_checkpoint");
+			detail::destroy_data(db);
+			if (!result)
+			{
+				std::cout << "test_snapshot_checkpoint failed." << std::endl;
+				return;
+			}
+		}
+
+		db_type db{ "d:/temp/tmp/test_db_install" };
+		db.put("stale_key", "stale_value");
+		std::ifstream in{ snapshot_file, std::ios::binary };
+		db.install_from_file(in);
+		for (auto loop = 0ull; loop < sizeof(detail::keys) / sizeof(std::string); ++loop)
+		{
+			if (db.get(detail::keys[loop]) != detail::values[loop])
+			{
+				std::cout << "test_snapshot_checkpoint failed." << std::endl;
+				return;
+			}
+		}
+		if (db.get("after_checkpoint") != "timax")
+		{
+			std::cout << "test_snapshot_checkpoint failed." << std::endl;
+			return;
+		}
+		std::cout << "test_snapshot_checkpoint success." << std::endl;
+	}
+	catch (std::exception const& e)
+	{
+		std::cout << e.what() << std::endl;
+		std::cout << "test_snapshot_checkpoint failed." << std::endl;
+	}
+}
+
+void test_db_applied_index()
+{
+	std::cout << "test_db_applied_index" << std::endl;
+	try
+	{
+		{
+			db_type db{ "d:/temp/tmp/test_db" };
+			db.put("test_applied", "timax", 41);
+			db.del("test_applied", 42);
+		}
+		db_type db{ "d:/temp/tmp/test_db" };
+		if (db.get_applied_index() != 42)
+		{
+			std::cout << "test_db_applied_index failed." << std::endl;
+			return;
+		}
+		std::cout << "test_db_applied_index success." << std::endl;
+	}
+	catch (std::exception const& e)
+	{
+		std::cout << e.what() << std::endl;
+		std::cout << "test_db_applied_index failed." << std::endl;
+	}
+}
+
 void test_db()
 {
 	test_db_put_get();
 	test_db_del();
+	test_db_applied_index();
 	test_snapshot();
 	test_snapshot_traverse();
+	test_snapshot_checkpoint();
 }
\ No newline at end of file
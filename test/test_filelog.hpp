@@ -0,0 +1,130 @@
+#pragma once
+#include <chrono>
+#include <future>
+#include <thread>
+
+using filelog_type = xraft::detail::filelog;
+
+namespace test_filelog_detail
+{
+	std::string const filelog_path = test_base_path + "test_filelog/";
+
+	void clear_filelog_dir()
+	{
+		xraft::functors::fs::mkdir()(filelog_path);
+		for (auto const& file : xraft::functors::fs::ls_files()(filelog_path))
+			xraft::functors::fs::rm()(file);
+	}
+
+	xraft::detail::log_entry make_entry(std::size_t bytes = 16)
+	{
+		xraft::detail::log_entry entry;
+		entry.term_ = 1;
+		entry.log_data_.resize(bytes, 'x');
+		return entry;
+	}
+}
+
+//a persisted callback may lock what a writer holds while it waits for
+//the background writes, the log must not stall on it.
+void test_filelog_persist_callback_lock()
+{
+	using namespace test_filelog_detail;
+	clear_filelog_dir();
+	filelog_type log;
+	log.init(filelog_path);
+
+	std::mutex mtx;
+	std::atomic<int64_t> persisted{ 0 };
+	log.set_persisted_callback([&](int64_t index)
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		persisted = index;
+	});
+
+	std::promise<int64_t> done;
+	auto result = done.get_future();
+	std::thread([&]
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		int64_t index = 0;
+		for (int loop = 0; loop < 10; ++loop)
+			log.append(make_entry(), index);
+		//waits for the appends, their callbacks wait for mtx.
+		log.write(make_entry(), index);
+		done.set_value(index);
+	}).detach();
+
+	if (result.wait_for(std::chrono::seconds(10)) != std::future_status::ready)
+	{
+		//the writer and the log threads are stuck, nothing can clean up.
+		std::cout << "test_filelog_persist_callback_lock failed! deadlock" << std::endl;
+		std::exit(1);
+	}
+	auto last_index = result.get();
+	for (int loop = 0; loop < 1000 && persisted < last_index - 1; ++loop)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	xraft::detail::log_entry entry;
+	if (persisted != last_index - 1 || log.get_last_index() != last_index ||
+		!log.get_log_entry(last_index, entry) || entry.index_ != last_index)
+	{
+		std::cout << "test_filelog_persist_callback_lock failed!" << std::endl;
+		return;
+	}
+	std::cout << "test_filelog_persist_callback_lock success." << std::endl;
+}
+
+//a background batch that fails as the first one of a segment leaves
+//nothing behind, the next append reuses its index.
+void test_filelog_persist_fail_at_segment_start()
+{
+	using namespace test_filelog_detail;
+	clear_filelog_dir();
+	//bigger than the segment size, every write ends its segment.
+	const std::size_t bytes = 2048;
+	{
+		filelog_type log;
+		log.init(filelog_path);
+		int64_t index = 0;
+		log.write(make_entry(bytes), index);
+
+		log.set_persist_fault_hook([](int64_t first_index) { return first_index != 2; });
+		std::vector<xraft::detail::log_entry> entries;
+		for (int loop = 0; loop < 3; ++loop)
+			entries.emplace_back(make_entry(bytes));
+		log.append(std::move(entries), index);
+		if (log.get_persisted_index() != 1)
+		{
+			std::cout << "test_filelog_persist_fail_at_segment_start failed!" << std::endl;
+			return;
+		}
+
+		log.set_persist_fault_hook(nullptr);
+		auto entry = make_entry(bytes);
+		entry.log_data_.assign(bytes, 'y');
+		log.append(std::move(entry), index);
+		if (index != 2 || log.get_persisted_index() != 2)
+		{
+			std::cout << "test_filelog_persist_fail_at_segment_start failed!" << std::endl;
+			return;
+		}
+	}
+	filelog_type log;
+	log.init(filelog_path);
+	xraft::detail::log_entry entry;
+	if (log.get_last_index() != 2 || !log.get_log_entry(2, entry) ||
+		entry.index_ != 2 || entry.log_data_ != std::string(bytes, 'y'))
+	{
+		std::cout << "test_filelog_persist_fail_at_segment_start failed!" << std::endl;
+		return;
+	}
+	std::cout << "test_filelog_persist_fail_at_segment_start success." << std::endl;
+}
+
+void test_filelog()
+{
+	test_filelog_persist_callback_lock();
+	test_filelog_persist_fail_at_segment_start();
+	test_filelog_detail::clear_filelog_dir();
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+using hard_state_type = xraft::detail::hard_state;
+
+namespace test_hard_state_detail
+{
+	std::string const hard_state_path = "d:/temp/tmp/test_hard_state/";
+
+	void clear_hard_state_dir()
+	{
+		xraft::functors::fs::mkdir()(hard_state_path);
+		for (auto const& file : xraft::functors::fs::ls_files()(hard_state_path))
+			xraft::functors::fs::rm()(file);
+	}
+}
+
+void test_hard_state_reload()
+{
+	using namespace test_hard_state_detail;
+	clear_hard_state_dir();
+	{
+		hard_state_type state;
+		state.init(hard_state_path);
+		if (state.is_loaded())
+		{
+			std::cout << "test_hard_state_reload failed!" << std::endl;
+			return;
+		}
+		state.set_term_vote(3, "9010");
+		state.set_committed(100);
+		state.set_applied(90);
+		state.flush();
+		state.set_term_vote(4, "9011");
+	}
+	hard_state_type state;
+	state.init(hard_state_path);
+	if (!state.is_loaded() ||
+		state.get_term() != 4 ||
+		state.get_vote() != "9011" ||
+		state.get_committed() != 100 ||
+		state.get_applied() != 90)
+	{
+		std::cout << "test_hard_state_reload failed!" << std::endl;
+		return;
+	}
+	std::cout << "test_hard_state_reload success." << std::endl;
+}
+
+void test_hard_state_torn_write()
+{
+	using namespace test_hard_state_detail;
+	clear_hard_state_dir();
+	{
+		hard_state_type state;
+		state.init(hard_state_path);
+		state.set_term_vote(5, "9010");
+		state.set_term_vote(6, "9012");
+	}
+	{
+		//corrupt the newer slot as if the crash hit in the middle of its write.
+		std::fstream file(hard_state_path + "hard_state",
+			std::ios::binary | std::ios::in | std::ios::out);
+		file.seekp(0, std::ios::beg);
+		file.write("torn", 4);
+	}
+	hard_state_type state;
+	state.init(hard_state_path);
+	if (state.get_term() != 5 || state.get_vote() != "9010")
+	{
+		std::cout << "test_hard_state_torn_write failed!" << std::endl;
+		return;
+	}
+	std::cout << "test_hard_state_torn_write success." << std::endl;
+}
+
+void test_hard_state()
+{
+	test_hard_state_reload();
+	test_hard_state_torn_write();
+}
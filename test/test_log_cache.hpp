@@ -0,0 +1,99 @@
+#pragma once
+
+using log_cache_type = xraft::detail::log_cache;
+
+namespace test_log_cache_detail
+{
+	xraft::detail::log_entry make_entry(int64_t index)
+	{
+		xraft::detail::log_entry entry;
+		entry.index_ = index;
+		entry.term_ = 1;
+		entry.log_data_ = "value" + std::to_string(index);
+		return entry;
+	}
+}
+
+void test_log_cache_get()
+{
+	using namespace test_log_cache_detail;
+	log_cache_type cache;
+	for (int64_t loop = 1; loop <= 100; ++loop)
+		cache.push(make_entry(loop));
+
+	xraft::detail::log_entry entry;
+	if (!cache.get(50, entry) || entry.index_ != 50 || entry.log_data_ != "value50")
+	{
+		std::cout << "test_log_cache_get failed!" << std::endl;
+		return;
+	}
+
+	int64_t index = 90;
+	std::size_t count = 20;
+	std::list<xraft::detail::log_entry> entries;
+	cache.get(index, count, entries);
+	if (entries.size() != 11 || index != 101 || count != 9 ||
+		entries.front().index_ != 90 || entries.back().index_ != 100)
+	{
+		std::cout << "test_log_cache_get failed!" << std::endl;
+		return;
+	}
+	std::cout << "test_log_cache_get success." << std::endl;
+}
+
+void test_log_cache_evict()
+{
+	using namespace test_log_cache_detail;
+	log_cache_type cache;
+	auto bytes = make_entry(1).bytes();
+	cache.set_max_bytes(bytes * 10);
+	for (int64_t loop = 1; loop <= 9; ++loop)
+		cache.push(make_entry(loop));
+	for (int64_t loop = 10; loop <= 100; ++loop)
+		cache.push(make_entry(loop));
+
+	xraft::detail::log_entry entry;
+	if (cache.bytes() > bytes * 10 || cache.get(1, entry) ||
+		!cache.get(100, entry) || cache.get_last_index() != 100)
+	{
+		std::cout << "test_log_cache_evict failed!" << std::endl;
+		return;
+	}
+	std::cout << "test_log_cache_evict success." << std::endl;
+}
+
+void test_log_cache_truncate()
+{
+	using namespace test_log_cache_detail;
+	log_cache_type cache;
+	for (int64_t loop = 1; loop <= 100; ++loop)
+		cache.push(make_entry(loop));
+
+	cache.truncate_prefix(10);
+	cache.truncate_suffix(91);
+	xraft::detail::log_entry entry;
+	if (cache.get_first_index() != 11 || cache.get_last_index() != 90 ||
+		cache.get(10, entry) || cache.get(91, entry))
+	{
+		std::cout << "test_log_cache_truncate failed!" << std::endl;
+		return;
+	}
+
+	// a follower rewrites the tail after a conflict
+	cache.push(make_entry(91));
+	// and a gap starts the cache over
+	cache.push(make_entry(200));
+	if (cache.get_first_index() != 200 || !cache.get(200, entry))
+	{
+		std::cout << "test_log_cache_truncate failed!" << std::endl;
+		return;
+	}
+	std::cout << "test_log_cache_truncate success." << std::endl;
+}
+
+void test_log_cache()
+{
+	test_log_cache_get();
+	test_log_cache_evict();
+	test_log_cache_truncate();
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+using metadata_type = xraft::detail::metadata<>;
+
+namespace test_metadata_detail
+{
+	std::string const metadata_path = "d:/temp/tmp/test_metadata/";
+
+	void clear_dir(const std::string &path)
+	{
+		xraft::functors::fs::mkdir()(path);
+		for (auto const& file : xraft::functors::fs::ls_files()(path))
+			xraft::functors::fs::rm()(file);
+	}
+
+	void copy_file(const std::string &from, const std::string &to)
+	{
+		std::ifstream in(from, std::ios::binary);
+		std::ofstream out(to, std::ios::binary | std::ios::trunc);
+		out << in.rdbuf();
+	}
+
+	void touch_file(const std::string &filepath, const std::string &data = "")
+	{
+		std::ofstream out(filepath, std::ios::binary | std::ios::trunc);
+		out << data;
+	}
+
+	//state A: a = "1", x = 1.
+	void set_a(metadata_type &metadata)
+	{
+		metadata.set("a", "1");
+		metadata.set("x", 1);
+	}
+
+	//state B on top of A: b = "2", x = 2, a deleted.
+	void set_b(metadata_type &metadata)
+	{
+		metadata.set("b", "2");
+		metadata.set("x", 2);
+		metadata.del("a");
+	}
+
+	bool check_a_b(const std::string &path)
+	{
+		metadata_type metadata;
+		if (!metadata.init(path))
+			return false;
+		std::string a, b;
+		int64_t x = 0;
+		return !metadata.get("a", a) &&
+			metadata.get("b", b) && b == "2" &&
+			metadata.get("x", x) && x == 2;
+	}
+
+	//crash images of a compaction from generation 1 to 2:
+	//the logs of A (1.Log) and B (2.Log), and a complete 2.data of A + B.
+	void make_images(const std::string &images)
+	{
+		clear_dir(images + "a/");
+		clear_dir(images + "b/");
+		clear_dir(images + "ab/");
+		{
+			metadata_type metadata;
+			metadata.init(images + "a/");
+			set_a(metadata);
+			copy_file(images + "a/1.Log", images + "1.Log");
+		}
+		{
+			metadata_type metadata;
+			metadata.init(images + "b/");
+			set_b(metadata);
+			copy_file(images + "b/1.Log", images + "2.Log");
+		}
+		{
+			metadata_type metadata;
+			metadata.init(images + "ab/");
+			set_a(metadata);
+			set_b(metadata);
+		}
+		//the destructor compacted ab/ into 2.data.
+		copy_file(images + "ab/2.data", images + "2.data");
+	}
+}
+
+void test_metadata_background_compaction()
+{
+	using namespace test_metadata_detail;
+	auto path = metadata_path + "live/";
+	clear_dir(path);
+	{
+		metadata_type metadata;
+		metadata.init(path);
+		metadata.set_max_log_file(1024);
+		for (int64_t loop = 0; loop < 10000; ++loop)
+		{
+			if (!metadata.set("key" + std::to_string(loop % 100), loop))
+			{
+				std::cout << "test_metadata_background_compaction failed!" << std::endl;
+				return;
+			}
+		}
+		metadata.wait_compaction();
+	}
+	metadata_type metadata;
+	metadata.init(path);
+	for (int64_t loop = 0; loop < 100; ++loop)
+	{
+		int64_t value = 0;
+		if (!metadata.get("key" + std::to_string(loop), value) || value != 9900 + loop)
+		{
+			std::cout << "test_metadata_background_compaction failed!" << std::endl;
+			return;
+		}
+	}
+	std::cout << "test_metadata_background_compaction success." << std::endl;
+}
+
+void test_metadata_crash_recovery()
+{
+	using namespace test_metadata_detail;
+	auto images = metadata_path + "images/";
+	clear_dir(images);
+	make_images(images);
+	auto path = metadata_path + "crash/";
+
+	//crash right after the writes moved to 2.Log.
+	clear_dir(path);
+	copy_file(images + "1.Log", path + "1.Log");
+	touch_file(path + "1.metadata");
+	copy_file(images + "2.Log", path + "2.Log");
+	if (!check_a_b(path) || !check_a_b(path))
+	{
+		std::cout << "test_metadata_crash_recovery log switch failed!" << std::endl;
+		return;
+	}
+
+	//crash in the middle of writing 2.data.
+	clear_dir(path);
+	copy_file(images + "1.Log", path + "1.Log");
+	touch_file(path + "1.metadata");
+	copy_file(images + "2.Log", path + "2.Log");
+	touch_file(path + "2.data", "torn");
+	if (!check_a_b(path) || !check_a_b(path))
+	{
+		std::cout << "test_metadata_crash_recovery torn data failed!" << std::endl;
+		return;
+	}
+
+	//crash after 2.metadata, before the old files were removed.
+	clear_dir(path);
+	copy_file(images + "1.Log", path + "1.Log");
+	touch_file(path + "1.metadata");
+	copy_file(images + "2.Log", path + "2.Log");
+	copy_file(images + "2.data", path + "2.data");
+	touch_file(path + "2.metadata");
+	if (!check_a_b(path) || !check_a_b(path))
+	{
+		std::cout << "test_metadata_crash_recovery cleanup failed!" << std::endl;
+		return;
+	}
+	std::cout << "test_metadata_crash_recovery success." << std::endl;
+}
+
+void test_metadata()
+{
+	test_metadata_background_compaction();
+	test_metadata_crash_recovery();
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+namespace test_snapshot_codec_detail
+{
+	std::string const snapshot_path = "d:/temp/tmp/test_snapshot_codec/";
+
+	//compressible like real key-value data, with some noise.
+	std::string make_payload(std::size_t size)
+	{
+		std::mt19937 gen(1);
+		std::string payload;
+		while (payload.size() < size)
+		{
+			payload += "key" + std::to_string(payload.size() % 977) + "=value";
+			payload.push_back((char)(gen() & 0xff));
+		}
+		payload.resize(size);
+		return payload;
+	}
+
+	bool write_snapshot(const std::string &filepath, const std::string &payload, uint32_t codec)
+	{
+		xraft::functors::fs::mkdir()(snapshot_path);
+		xraft::detail::snapshot_writer writer;
+		xraft::detail::snapshot_head head;
+		head.last_included_index_ = 100;
+		head.last_included_term_ = 3;
+		if (codec != xraft::detail::snapshot_codecs::e_none)
+		{
+			head.version_ = xraft::detail::snapshot_head::e_block_version;
+			head.codec_ = codec;
+			writer.set_block_bytes(4096);
+		}
+		if (!writer.open(filepath) || !writer.write_sanpshot_head(head))
+			return false;
+		//odd sized writes, so blocks do not line up with them.
+		for (std::size_t pos = 0; pos < payload.size(); pos += 1000)
+		{
+			if (!writer.write(payload.substr(pos, 1000)))
+				return false;
+		}
+		auto result = writer.sync();
+		writer.close();
+		return result;
+	}
+
+	bool read_snapshot(const std::string &filepath, std::string &payload)
+	{
+		xraft::detail::snapshot_reader reader;
+		xraft::detail::snapshot_head head;
+		if (!reader.open(filepath) || !reader.read_sanpshot_head(head))
+			return false;
+		if (head.last_included_index_ != 100 || head.last_included_term_ != 3)
+			return false;
+		auto &stream = reader.get_snapshot_stream();
+		//peek and seek back, as the checkpoint manifest check does.
+		auto pos = stream.tellg();
+		char peek[12];
+		stream.read(peek, sizeof(peek));
+		stream.seekg(pos);
+		payload.clear();
+		char buffer[777];
+		while (stream.read(buffer, sizeof(buffer)) || stream.gcount())
+			payload.append(buffer, (std::size_t)stream.gcount());
+		return true;
+	}
+
+	int64_t file_size(const std::string &filepath)
+	{
+		std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+		return file.tellg();
+	}
+}
+
+void test_snapshot_codec_roundtrip()
+{
+	using namespace test_snapshot_codec_detail;
+	using xraft::detail::snapshot_codecs;
+	auto payload = make_payload(1024 * 1024 + 123);
+	auto raw_file = snapshot_path + "raw.ss";
+	auto lz_file = snapshot_path + "lz.ss";
+	std::string raw, lz;
+	if (!write_snapshot(raw_file, payload, snapshot_codecs::e_none) ||
+		!write_snapshot(lz_file, payload, snapshot_codecs::e_lz) ||
+		!read_snapshot(raw_file, raw) ||
+		!read_snapshot(lz_file, lz) ||
+		raw != payload || lz != payload)
+	{
+		std::cout << "test_snapshot_codec_roundtrip failed!" << std::endl;
+		return;
+	}
+	std::cout << "	raw(" << file_size(raw_file) << " bytes) lz("
+		<< file_size(lz_file) << " bytes)\n";
+	if (file_size(lz_file) >= file_size(raw_file))
+	{
+		std::cout << "test_snapshot_codec_roundtrip failed!" << std::endl;
+		return;
+	}
+	std::cout << "test_snapshot_codec_roundtrip success." << std::endl;
+}
+
+void test_snapshot_codec_corrupted()
+{
+	using namespace test_snapshot_codec_detail;
+	using xraft::detail::snapshot_codecs;
+	auto lz_file = snapshot_path + "corrupted.ss";
+	write_snapshot(lz_file, make_payload(64 * 1024), snapshot_codecs::e_lz);
+	{
+		std::fstream file(lz_file, std::ios::binary | std::ios::in | std::ios::out);
+		file.seekp(xraft::detail::snapshot_head::e_block_size + 16, std::ios::beg);
+		file.write("\xff\xff\xff\xff", 4);
+	}
+	try
+	{
+		std::string payload;
+		read_snapshot(lz_file, payload);
+	}
+	catch (std::exception &)
+	{
+		std::cout << "test_snapshot_codec_corrupted success." << std::endl;
+		return;
+	}
+	std::cout << "test_snapshot_codec_corrupted failed!" << std::endl;
+}
+
+void test_snapshot_codec()
+{
+	test_snapshot_codec_roundtrip();
+	test_snapshot_codec_corrupted();
+}
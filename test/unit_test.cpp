@@ -3,12 +3,35 @@
 #include <storage/kv_storage.hpp>
 #include <storage/rocksdb_storage.hpp>
 #include <storage/raft_consensus.hpp>
+
+//benchmarks keep their files under this directory.
+std::string const test_base_path = "d:/temp/tmp/";
+
 #include "test_db.hpp"
-#include "test_sequence_list.hpp"
+#include "test_log_cache.hpp"
+#include "test_filelog.hpp"
+#include "test_hard_state.hpp"
+#include "test_metadata.hpp"
+#include "test_snapshot_codec.hpp"
+#include "bench_db.hpp"
+#include "bench_filelog.hpp"
+#include "bench_raft.hpp"
+#include "bench_timer.hpp"
 
-int main(void)
+//benchmarks take minutes and bind ports, run them with --bench.
+int main(int argc, char *argv[])
 {
 	test_db();
-	test_sequence_list();
+	test_log_cache();
+	test_filelog();
+	test_hard_state();
+	test_metadata();
+	test_snapshot_codec();
+	if (argc < 2 || std::string(argv[1]) != "--bench")
+		return 0;
+	bench_db();
+	bench_filelog();
+	bench_raft();
+	bench_timer();
 	return 0;
 }
\ No newline at end of file